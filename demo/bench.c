@@ -0,0 +1,781 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "gpudl.h"
+
+// run `./bench` for a list of benchmarks
+
+static WGPUDevice device;
+static WGPUQueue queue;
+
+static void get_wgpu(void)
+{
+	if (device) return;
+	gpudl_get_wgpu(NULL, NULL, &device, &queue);
+}
+
+// gpudl_shutdown() followed by gpudl_init(); the device and queue are
+// fetched again by the next get_wgpu()
+static void reinit(void)
+{
+	gpudl_shutdown();
+	device = NULL;
+	queue = NULL;
+	gpudl_init();
+}
+
+static void drain_events(void)
+{
+	struct gpudl_event e;
+	while (gpudl_wait_event(&e, 0)) {}
+}
+
+static void clear(WGPUTextureView view, double r, double g, double b)
+{
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, &(WGPUCommandEncoderDescriptor){0});
+	WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(
+		encoder,
+		&(WGPURenderPassDescriptor){
+			.colorAttachmentCount = 1,
+			.colorAttachments = &(WGPURenderPassColorAttachment){
+				.view = view,
+				.loadOp = WGPULoadOp_Clear,
+				.storeOp = WGPUStoreOp_Store,
+				.clearValue = (WGPUColor){.r=r, .g=g, .b=b, .a=1},
+			},
+		}
+	);
+	wgpuRenderPassEncoderEnd(pass);
+	WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(encoder, &(WGPUCommandBufferDescriptor){0});
+	wgpuQueueSubmit(queue, 1, &cmd);
+}
+
+// renders and presents a single cleared frame, waiting for the window to
+// become ready if necessary
+static void present_one_frame(int window_id)
+{
+	for (;;) {
+		WGPUTextureView view = gpudl_render_begin(window_id);
+		if (view) {
+			clear(view, 0.1, 0.2, 0.3);
+			gpudl_render_end();
+			return;
+		}
+		struct gpudl_event e;
+		gpudl_wait_event(&e, 1);
+	}
+}
+
+// waits until a frame presented after `t0` has hit the screen; returns its
+// time, or 0 if there's no presentation feedback
+static uint64_t wait_for_present(int window_id, uint64_t t0)
+{
+	const uint64_t give_up = gpudl_time_us() + 1000000;
+	while (gpudl_time_us() < give_up) {
+		struct gpudl_present_timing timing;
+		if (gpudl_window_get_present_timing(window_id, &timing) && timing.ust > t0) {
+			return timing.ust;
+		}
+		struct gpudl_event e;
+		gpudl_wait_event(&e, 1);
+	}
+	return 0;
+}
+
+static int bench_pool(int argc, char** argv)
+{
+	const int n = argc > 0 ? atoi(argv[0]) : 50;
+
+	// warm-up; the first window also creates the wgpu device
+	{
+		const int id = gpudl_window_open("bench");
+		get_wgpu();
+		present_one_frame(id);
+		gpudl_window_close(id);
+		drain_events();
+	}
+
+	for (int pass = 0; pass < 2; pass++) {
+		const int use_pool = (pass == 1);
+		gpudl_set_window_pool(use_pool ? 2 : 0, 256, 256);
+		drain_events();
+
+		uint64_t sum_submit = 0, max_submit = 0;
+		uint64_t sum_present = 0, max_present = 0;
+		int n_presents = 0;
+		for (int i = 0; i < n; i++) {
+			const uint64_t t0 = gpudl_time_us();
+			const int id = gpudl_window_open("bench");
+			present_one_frame(id);
+			const uint64_t t_submit = gpudl_time_us() - t0;
+			const uint64_t ust = wait_for_present(id, t0);
+			gpudl_window_close(id);
+			drain_events();
+
+			sum_submit += t_submit;
+			if (t_submit > max_submit) max_submit = t_submit;
+			if (ust > 0) {
+				const uint64_t t_present = ust - t0;
+				sum_present += t_present;
+				if (t_present > max_present) max_present = t_present;
+				n_presents++;
+			}
+		}
+
+		printf("pool %-3s open->first present submitted: mean %6.0fus  max %6luus\n",
+			use_pool ? "on" : "off",
+			(double)sum_submit / n,
+			(unsigned long)max_submit);
+		if (n_presents > 0) {
+			printf("pool %-3s open->first present on screen:  mean %6.0fus  max %6luus  (%d/%d)\n",
+				use_pool ? "on" : "off",
+				(double)sum_present / n_presents,
+				(unsigned long)max_present,
+				n_presents, n);
+		} else {
+			printf("pool %-3s (no presentation feedback)\n", use_pool ? "on" : "off");
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+static long read_rss_kb(void)
+{
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f == NULL) return -1;
+	long size, resident;
+	const int n = fscanf(f, "%ld %ld", &size, &resident);
+	fclose(f);
+	if (n != 2) return -1;
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// GPU memory of this process, as reported by DRM drivers in fdinfo
+// (drm-memory-*/drm-resident-* keys; recent amdgpu, i915, xe, ...). returns
+// -1 if the driver doesn't report it
+static long read_gpu_mem_kb(void)
+{
+	DIR* dir = opendir("/proc/self/fdinfo");
+	if (dir == NULL) return -1;
+	long total = -1;
+	struct dirent* de;
+	while ((de = readdir(dir)) != NULL) {
+		if (de->d_name[0] == '.') continue;
+		char path[300];
+		snprintf(path, sizeof path, "/proc/self/fdinfo/%s", de->d_name);
+		FILE* f = fopen(path, "r");
+		if (f == NULL) continue;
+		char line[256];
+		while (fgets(line, sizeof line, f)) {
+			if (strncmp(line, "drm-memory-", 11) != 0 && strncmp(line, "drm-resident-", 13) != 0) continue;
+			const char* colon = strchr(line, ':');
+			if (colon == NULL) continue;
+			long kb = 0;
+			char unit[8] = "";
+			if (sscanf(colon+1, "%ld %7s", &kb, unit) < 1) continue;
+			if (strcmp(unit, "MiB") == 0) kb *= 1024;
+			if (total < 0) total = 0;
+			total += kb;
+		}
+		fclose(f);
+	}
+	closedir(dir);
+	return total;
+}
+
+// compares the current RSS/GPU memory against the baseline; returns 1 if
+// either grew beyond the tolerance
+static int check_growth(const char* what, long rss0, long gpu0, long rss, long gpu)
+{
+	// allocators and drivers keep some slack around; anything beyond
+	// this is considered a leak
+	const long tolerance_kb = 4096;
+	int leaked = 0;
+	if (rss0 >= 0 && rss - rss0 > tolerance_kb) {
+		printf("FAIL: RSS grew by %ld KiB over %s\n", rss - rss0, what);
+		leaked = 1;
+	}
+	if (gpu0 >= 0 && gpu - gpu0 > tolerance_kb) {
+		printf("FAIL: GPU memory grew by %ld KiB over %s\n", gpu - gpu0, what);
+		leaked = 1;
+	}
+	return leaked;
+}
+
+static void churn_one_window(void)
+{
+	const int id = gpudl_window_open("churn");
+	get_wgpu();
+	present_one_frame(id);
+	gpudl_window_close(id);
+	drain_events();
+}
+
+static int bench_churn(int argc, char** argv)
+{
+	const int n = argc > 0 ? atoi(argv[0]) : 10000;
+	const int n_reinits = argc > 1 ? atoi(argv[1]) : 20;
+	const int n_warmup = 100;
+	const int n_samples = 10;
+
+	long rss0 = -1, gpu0 = -1, rss = -1, gpu = -1;
+	for (int i = -n_warmup; i < n; i++) {
+		churn_one_window();
+
+		if (i == -1) {
+			rss0 = read_rss_kb();
+			gpu0 = read_gpu_mem_kb();
+			printf("%6s %10s %10s\n", "iter", "rss KiB", "gpu KiB");
+			printf("%6d %10ld %10ld\n", 0, rss0, gpu0);
+		} else if (i >= 0 && ((i+1) % (n/n_samples > 0 ? n/n_samples : 1)) == 0) {
+			rss = read_rss_kb();
+			gpu = read_gpu_mem_kb();
+			printf("%6d %10ld %10ld\n", i+1, rss, gpu);
+		}
+	}
+	int leaked = check_growth("window churn", rss0, gpu0, rss, gpu);
+
+	// everything gpudl_init() and the first window create must go with
+	// gpudl_shutdown(). the first cycles load the driver for good, so
+	// they don't count
+	const int n_reinit_warmup = 2;
+	for (int i = -n_reinit_warmup; i < n_reinits; i++) {
+		reinit();
+		churn_one_window();
+
+		if (i == -1) {
+			rss0 = read_rss_kb();
+			gpu0 = read_gpu_mem_kb();
+			printf("%6s %10s %10s\n", "reinit", "rss KiB", "gpu KiB");
+			printf("%6d %10ld %10ld\n", 0, rss0, gpu0);
+		} else if (i == n_reinits-1) {
+			rss = read_rss_kb();
+			gpu = read_gpu_mem_kb();
+			printf("%6d %10ld %10ld\n", i+1, rss, gpu);
+		}
+	}
+	if (n_reinits > 0) leaked |= check_growth("shutdown/init cycles", rss0, gpu0, rss, gpu);
+
+	if (gpu0 < 0) printf("(driver doesn't report per-process GPU memory)\n");
+	if (!leaked) printf("OK\n");
+
+	gpudl_shutdown();
+	return leaked ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+struct stream_image {
+	int size;
+	int seed;
+};
+
+// stands in for an image decoder
+static uint8_t* decode_stream_image(void* userdata, int* width, int* height)
+{
+	const struct stream_image* img = userdata;
+	uint8_t* pixels = malloc((size_t)img->size * img->size * 4);
+	if (pixels == NULL) return NULL;
+	uint8_t* p = pixels;
+	for (int y = 0; y < img->size; y++) {
+		for (int x = 0; x < img->size; x++) {
+			*(p++) = x ^ img->seed;
+			*(p++) = y;
+			*(p++) = (x+y) ^ img->seed;
+			*(p++) = 255;
+		}
+	}
+	*width = img->size;
+	*height = img->size;
+	return pixels;
+}
+
+static int bench_stream(int argc, char** argv)
+{
+	const int n = argc > 0 ? atoi(argv[0]) : 16;
+	const int size = argc > 1 ? atoi(argv[1]) : 2048;
+	const int budget_mb = argc > 2 ? atoi(argv[2]) : 8;
+
+	const int id = gpudl_window_open("stream");
+	get_wgpu();
+	present_one_frame(id);
+	drain_events();
+	gpudl_set_stream_upload_budget((size_t)budget_mb << 20);
+
+	struct stream_image* images = calloc(n, sizeof *images);
+	int* handles = calloc(n, sizeof *handles);
+	const uint64_t t0 = gpudl_time_us();
+	for (int i = 0; i < n; i++) {
+		images[i] = (struct stream_image){ .size = size, .seed = i };
+		handles[i] = gpudl_stream_texture(decode_stream_image, &images[i]);
+	}
+
+	// keep rendering while streaming, like an application would
+	uint64_t t_first = 0, max_frame = 0;
+	int n_frames = 0;
+	for (;;) {
+		int n_done = 0, n_resident = 0;
+		for (int i = 0; i < n; i++) {
+			int mip;
+			gpudl_get_streamed_texture(handles[i], &mip);
+			assert((mip != -2) && "decode failed");
+			if (mip >= 0) n_resident++;
+			if (mip == 0) n_done++;
+		}
+		if (n_resident > 0 && t_first == 0) t_first = gpudl_time_us();
+		if (n_done == n) break;
+
+		const uint64_t t = gpudl_time_us();
+		WGPUTextureView view = gpudl_render_begin(id);
+		if (view) {
+			clear(view, 0.1, 0.2, 0.3);
+			gpudl_render_end();
+			const uint64_t dt = gpudl_time_us() - t;
+			if (dt > max_frame) max_frame = dt;
+			n_frames++;
+		} else {
+			// not rendering; keep uploads going anyway
+			gpudl_pump_streamed_textures();
+		}
+		struct gpudl_event e;
+		while (gpudl_poll_event(&e)) {}
+	}
+	wgpuDevicePoll(device, true);
+	const uint64_t t1 = gpudl_time_us();
+
+	const double mb = (double)n * size * size * 4 / (1 << 20);
+	const double s = (t1 - t0) * 1e-6;
+	printf("%d textures of %d×%d (%.1f MiB), budget %d MiB/frame\n", n, size, size, mb, budget_mb);
+	printf("first resident after %.1fms; all resident after %.1fms: %.1f MiB/s\n", (t_first - t0) * 1e-3, s * 1e3, mb / s);
+	printf("%d frames rendered meanwhile, longest %.1fms\n", n_frames, max_frame * 1e-3);
+
+	for (int i = 0; i < n; i++) gpudl_free_streamed_texture(handles[i]);
+	free(handles);
+	free(images);
+	gpudl_shutdown();
+	return EXIT_SUCCESS;
+}
+
+static WGPUTextureView make_texture(uint32_t argb)
+{
+	const int size = 64;
+	WGPUTexture texture = wgpuDeviceCreateTexture(device, &(WGPUTextureDescriptor){
+		.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst,
+		.dimension = WGPUTextureDimension_2D,
+		.size = (WGPUExtent3D){ .width = size, .height = size, .depthOrArrayLayers = 1 },
+		.format = WGPUTextureFormat_RGBA8Unorm,
+		.mipLevelCount = 1,
+		.sampleCount = 1,
+	});
+	uint8_t* pixels = malloc(size * size * 4);
+	for (int i = 0; i < size*size; i++) {
+		// 0xAARRGGBB as the R,G,B,A bytes of RGBA8Unorm
+		const uint32_t c = ((i ^ (i/size)) & 8) ? argb : 0xffffffff;
+		pixels[i*4+0] = c >> 16;
+		pixels[i*4+1] = c >> 8;
+		pixels[i*4+2] = c;
+		pixels[i*4+3] = c >> 24;
+	}
+	wgpuQueueWriteTexture(
+		queue,
+		&(WGPUImageCopyTexture){ .texture = texture, .aspect = WGPUTextureAspect_All },
+		pixels, size * size * 4,
+		&(WGPUTextureDataLayout){ .bytesPerRow = size * 4, .rowsPerImage = size },
+		&(WGPUExtent3D){ .width = size, .height = size, .depthOrArrayLayers = 1 });
+	free(pixels);
+	return wgpuTextureCreateView(texture, &(WGPUTextureViewDescriptor){
+		.format = WGPUTextureFormat_RGBA8Unorm,
+		.dimension = WGPUTextureViewDimension_2D,
+		.mipLevelCount = 1,
+		.arrayLayerCount = 1,
+		.aspect = WGPUTextureAspect_All,
+	});
+}
+
+static int bench_2d(int argc, char** argv)
+{
+	const int n = argc > 0 ? atoi(argv[0]) : 100000;
+	const int n_frames = argc > 1 ? atoi(argv[1]) : 200;
+
+	const int id = gpudl_window_open_ex(&(struct gpudl_window_desc){
+		.title = "2d",
+		.width = 1024,
+		.height = 768,
+		// don't let vsync hide the CPU cost
+		.present_mode = GPUDL_PRESENT_IMMEDIATE,
+	});
+	get_wgpu();
+	present_one_frame(id);
+	WGPUTextureView textures[2] = { make_texture(0xffff0000), make_texture(0xff0000ff) };
+
+	gpudl_2d_reset_stats();
+	uint64_t draw_us = 0;
+	int frame = 0;
+	const uint64_t t0 = gpudl_time_us();
+	while (frame < n_frames) {
+		WGPUTextureView view = gpudl_render_begin(id);
+		if (view == NULL) {
+			struct gpudl_event e;
+			gpudl_wait_event(&e, 1);
+			continue;
+		}
+		const uint64_t t = gpudl_time_us();
+		WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, &(WGPUCommandEncoderDescriptor){0});
+		// interleaves state changes like a naive UI would; sorting
+		// should merge them back into a handful of draws
+		uint32_t rnd = frame * 2654435761u;
+		for (int i = 0; i < n; i++) {
+			rnd = rnd * 1664525u + 1013904223u;
+			const float x = (rnd >> 8) % 1024;
+			const float y = (rnd >> 18) % 768;
+			const uint32_t argb = 0x80000000 | (rnd & 0xffffff);
+			switch (i & 3) {
+			case 0:
+				gpudl_2d_set_texture(NULL);
+				gpudl_2d_rect(x, y, 8, 8, argb);
+				break;
+			case 1:
+				gpudl_2d_set_texture(textures[(i>>2)&1]);
+				gpudl_2d_textured_rect(x, y, 16, 16, 0, 0, 1, 1, 0xffffffff);
+				break;
+			case 2:
+				gpudl_2d_set_texture(NULL);
+				gpudl_2d_line(x, y, x+20, y+10, 1.5f, argb);
+				break;
+			case 3:
+				gpudl_2d_set_texture(NULL);
+				gpudl_2d_triangle(x, y, x+10, y, x+5, y+9, argb);
+				break;
+			}
+		}
+		gpudl_2d_flush(encoder, view, WGPUTextureFormat_Undefined, &(WGPUColor){ .r = 0.1, .g = 0.1, .b = 0.1, .a = 1 });
+		WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(encoder, &(WGPUCommandBufferDescriptor){0});
+		wgpuQueueSubmit(queue, 1, &cmd);
+		draw_us += gpudl_time_us() - t;
+		gpudl_render_end();
+		frame++;
+		struct gpudl_event e;
+		while (gpudl_poll_event(&e)) {}
+	}
+	wgpuDevicePoll(device, true);
+	const uint64_t total_us = gpudl_time_us() - t0;
+
+	struct gpudl_2d_stats stats;
+	gpudl_2d_get_stats(&stats);
+	const double n_prims = (double)n * n_frames;
+	printf("%d frames of %d primitives\n", n_frames, n);
+	printf("cpu (draw+flush+submit): %8.2f Mprims/s\n", n_prims / draw_us);
+	printf("end-to-end:              %8.2f Mprims/s (%.1f fps)\n", n_prims / total_us, n_frames / (total_us * 1e-6));
+	printf("state runs per frame: %.0f; draws per frame after sorting: %.1f\n", (double)stats.n_commands / stats.n_flushes, (double)stats.n_draws / stats.n_flushes);
+
+	gpudl_shutdown();
+	return EXIT_SUCCESS;
+}
+
+struct bundle_bench {
+	WGPURenderPipeline pipeline;
+	WGPUBuffer offsets;
+	int n_draws;
+};
+
+// one small triangle per draw, placed by a per-instance offset; the vertex
+// buffer is rebound for every draw like per-object state would be
+static const char* bundle_bench_shader =
+	"@vertex fn vs_main(@builtin(vertex_index) i: u32, @location(0) offset: vec2<f32>) -> @builtin(position) vec4<f32> {\n"
+	"	let corner = vec2<f32>(f32(i & 1u), f32(i >> 1u)) * 0.01;\n"
+	"	return vec4<f32>(offset + corner, 0.0, 1.0);\n"
+	"}\n"
+	"@fragment fn fs_main() -> @location(0) vec4<f32> {\n"
+	"	return vec4<f32>(1.0, 0.5, 0.0, 1.0);\n"
+	"}\n";
+
+static void record_bundle_bench(WGPURenderBundleEncoder encoder, const uint64_t* variant, int n_variant, void* userdata)
+{
+	struct bundle_bench* bb = userdata;
+	wgpuRenderBundleEncoderSetPipeline(encoder, bb->pipeline);
+	for (int i = 0; i < bb->n_draws; i++) {
+		wgpuRenderBundleEncoderSetVertexBuffer(encoder, 0, bb->offsets, i*8, 8);
+		wgpuRenderBundleEncoderDraw(encoder, 3, 1, 0, 0);
+	}
+}
+
+static int bench_bundle(int argc, char** argv)
+{
+	const int n_draws = argc > 0 ? atoi(argv[0]) : 10000;
+	const int n_frames = argc > 1 ? atoi(argv[1]) : 100;
+
+	const int id = gpudl_window_open_ex(&(struct gpudl_window_desc){
+		.title = "bundle",
+		.width = 512,
+		.height = 512,
+		.present_mode = GPUDL_PRESENT_IMMEDIATE,
+	});
+	get_wgpu();
+	present_one_frame(id);
+
+	WGPUShaderModule module = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor){
+		.nextInChain = (const WGPUChainedStruct*)&(WGPUShaderModuleWGSLDescriptor){
+			.chain = (WGPUChainedStruct){ .sType = WGPUSType_ShaderModuleWGSLDescriptor },
+			.code = bundle_bench_shader,
+		},
+	});
+	struct bundle_bench bb = { .n_draws = n_draws };
+	bb.pipeline = wgpuDeviceCreateRenderPipeline(device, &(WGPURenderPipelineDescriptor){
+		.vertex = (WGPUVertexState){
+			.module = module,
+			.entryPoint = "vs_main",
+			.bufferCount = 1,
+			.buffers = &(WGPUVertexBufferLayout){
+				.arrayStride = 8,
+				.stepMode = WGPUVertexStepMode_Instance,
+				.attributeCount = 1,
+				.attributes = &(WGPUVertexAttribute){ .format = WGPUVertexFormat_Float32x2, .offset = 0, .shaderLocation = 0 },
+			},
+		},
+		.primitive = (WGPUPrimitiveState){
+			.topology = WGPUPrimitiveTopology_TriangleList,
+			.frontFace = WGPUFrontFace_CCW,
+			.cullMode = WGPUCullMode_None,
+		},
+		.multisample = (WGPUMultisampleState){ .count = 1, .mask = ~0 },
+		.fragment = &(WGPUFragmentState){
+			.module = module,
+			.entryPoint = "fs_main",
+			.targetCount = 1,
+			.targets = &(WGPUColorTargetState){
+				.format = gpudl_get_preferred_swap_chain_texture_format(),
+				.writeMask = WGPUColorWriteMask_All,
+			},
+		},
+	});
+	assert(bb.pipeline != NULL);
+
+	float* offsets = malloc(n_draws * 8);
+	assert(offsets != NULL);
+	for (int i = 0; i < n_draws; i++) {
+		offsets[i*2+0] = (i % 100) * 0.02f - 1.0f;
+		offsets[i*2+1] = ((i / 100) % 100) * 0.02f - 1.0f;
+	}
+	bb.offsets = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+		.usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
+		.size = n_draws * 8,
+	});
+	wgpuQueueWriteBuffer(queue, bb.offsets, 0, offsets, n_draws * 8);
+	free(offsets);
+
+	const int bundle = gpudl_bundle_create(record_bundle_bench, &bb);
+
+	printf("%d frames of %d draws\n", n_frames, n_draws);
+	for (int use_bundle = 0; use_bundle <= 1; use_bundle++) {
+		uint64_t encode_us = 0, max_encode_us = 0;
+		int frame = 0;
+		while (frame < n_frames) {
+			WGPUTextureView view = gpudl_render_begin(id);
+			if (view == NULL) {
+				struct gpudl_event e;
+				gpudl_wait_event(&e, 1);
+				continue;
+			}
+			WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, &(WGPUCommandEncoderDescriptor){0});
+			WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(encoder, &(WGPURenderPassDescriptor){
+				.colorAttachmentCount = 1,
+				.colorAttachments = &(WGPURenderPassColorAttachment){
+					.view = view,
+					.loadOp = WGPULoadOp_Clear,
+					.storeOp = WGPUStoreOp_Store,
+					.clearValue = (WGPUColor){ .a = 1 },
+				},
+			});
+			const uint64_t t = gpudl_time_us();
+			if (use_bundle) {
+				gpudl_bundle_execute(bundle, pass, NULL, 0);
+			} else {
+				wgpuRenderPassEncoderSetPipeline(pass, bb.pipeline);
+				for (int i = 0; i < n_draws; i++) {
+					wgpuRenderPassEncoderSetVertexBuffer(pass, 0, bb.offsets, i*8, 8);
+					wgpuRenderPassEncoderDraw(pass, 3, 1, 0, 0);
+				}
+			}
+			wgpuRenderPassEncoderEnd(pass);
+			WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(encoder, &(WGPUCommandBufferDescriptor){0});
+			const uint64_t dt = gpudl_time_us() - t;
+			wgpuQueueSubmit(queue, 1, &cmd);
+			gpudl_render_end();
+			// the first bundle frame includes the recording
+			if (!use_bundle || frame > 0) {
+				encode_us += dt;
+				if (dt > max_encode_us) max_encode_us = dt;
+			} else {
+				printf("bundle recording: %.2f ms\n", dt * 1e-3);
+			}
+			frame++;
+			struct gpudl_event e;
+			while (gpudl_poll_event(&e)) {}
+		}
+		const int n_timed = use_bundle ? n_frames-1 : n_frames;
+		printf("%-8s encode+finish: %8.3f ms/frame avg, %8.3f ms max, %6.1f ns/draw\n",
+			use_bundle ? "bundle" : "direct",
+			encode_us * 1e-3 / n_timed,
+			max_encode_us * 1e-3,
+			encode_us * 1e3 / ((double)n_timed * n_draws));
+	}
+
+	struct gpudl_object_cache_stats stats;
+	gpudl_get_bundle_stats(&stats);
+	printf("bundle replays: %d; recordings: %d\n", stats.n_hits, stats.n_misses);
+
+	gpudl_bundle_destroy(bundle);
+	wgpuBufferDestroy(bb.offsets);
+	gpudl_shutdown();
+	return EXIT_SUCCESS;
+}
+
+// post-processing chain for the graph benchmark; each pass just clears its
+// output, since the point is allocation and culling, not shading
+struct graph_bench_pass {
+	int output;
+};
+
+static void graph_bench_clear(WGPUCommandEncoder encoder, void* userdata)
+{
+	struct graph_bench_pass* p = userdata;
+	WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(encoder, &(WGPURenderPassDescriptor){
+		.colorAttachmentCount = 1,
+		.colorAttachments = &(WGPURenderPassColorAttachment){
+			.view = gpudl_graph_get_view(p->output),
+			.loadOp = WGPULoadOp_Clear,
+			.storeOp = WGPUStoreOp_Store,
+			.clearValue = (WGPUColor){ .r = 0.2, .g = 0.1, .b = 0.3, .a = 1 },
+		},
+	});
+	wgpuRenderPassEncoderEnd(pass);
+}
+
+static int bench_graph(int argc, char** argv)
+{
+	const int n_frames = argc > 0 ? atoi(argv[0]) : 200;
+	const int width = 1280, height = 720;
+
+	const int id = gpudl_window_open_ex(&(struct gpudl_window_desc){
+		.title = "graph",
+		.width = width,
+		.height = height,
+		.present_mode = GPUDL_PRESENT_IMMEDIATE,
+	});
+	get_wgpu();
+	present_one_frame(id);
+
+	struct gpudl_graph_stats warm = {0};
+	uint64_t build_us = 0;
+	int frame = 0;
+	while (frame < n_frames) {
+		WGPUTextureView view = gpudl_render_begin(id);
+		if (view == NULL) {
+			struct gpudl_event e;
+			gpudl_wait_event(&e, 1);
+			continue;
+		}
+		const uint64_t t = gpudl_time_us();
+		gpudl_graph_begin(view, width, height);
+		const struct gpudl_graph_texture_desc hdr = { .format = WGPUTextureFormat_RGBA16Float };
+		const struct gpudl_graph_texture_desc half = { .width = width/2, .height = height/2, .format = WGPUTextureFormat_RGBA16Float };
+		const int scene = gpudl_graph_create_texture(&hdr);
+		const int bright = gpudl_graph_create_texture(&half);
+		const int blur_h = gpudl_graph_create_texture(&half);
+		const int blur_v = gpudl_graph_create_texture(&half);
+		const int tonemapped = gpudl_graph_create_texture(&hdr);
+		const int debug = gpudl_graph_create_texture(&hdr);
+		struct graph_bench_pass passes[] = {
+			{ scene }, { bright }, { blur_h }, { blur_v }, { tonemapped }, { debug }, { GPUDL_GRAPH_BACKBUFFER },
+		};
+		int p;
+		p = gpudl_graph_add_pass("scene", graph_bench_clear, &passes[0]);
+		gpudl_graph_write(p, scene);
+		p = gpudl_graph_add_pass("bright", graph_bench_clear, &passes[1]);
+		gpudl_graph_read(p, scene);
+		gpudl_graph_write(p, bright);
+		p = gpudl_graph_add_pass("blur_h", graph_bench_clear, &passes[2]);
+		gpudl_graph_read(p, bright);
+		gpudl_graph_write(p, blur_h);
+		p = gpudl_graph_add_pass("blur_v", graph_bench_clear, &passes[3]);
+		gpudl_graph_read(p, blur_h);
+		gpudl_graph_write(p, blur_v);
+		p = gpudl_graph_add_pass("tonemap", graph_bench_clear, &passes[4]);
+		gpudl_graph_read(p, scene);
+		gpudl_graph_read(p, blur_v);
+		gpudl_graph_write(p, tonemapped);
+		// a debug view that's switched off; nothing reads it
+		p = gpudl_graph_add_pass("debug", graph_bench_clear, &passes[5]);
+		gpudl_graph_read(p, scene);
+		gpudl_graph_write(p, debug);
+		p = gpudl_graph_add_pass("present", graph_bench_clear, &passes[6]);
+		gpudl_graph_read(p, tonemapped);
+		gpudl_graph_write(p, GPUDL_GRAPH_BACKBUFFER);
+		gpudl_graph_execute();
+		build_us += gpudl_time_us() - t;
+		gpudl_render_end();
+		if (frame == 0) gpudl_graph_get_stats(&warm);
+		frame++;
+		struct gpudl_event e;
+		while (gpudl_poll_event(&e)) {}
+	}
+	wgpuDevicePoll(device, true);
+
+	struct gpudl_graph_stats stats;
+	gpudl_graph_get_stats(&stats);
+	printf("%d frames\n", n_frames);
+	printf("passes: %d, culled: %d\n", stats.n_passes, stats.n_culled);
+	printf("transient textures: %d, backed by %d pooled textures\n", stats.n_transient, stats.n_pooled);
+	printf("VRAM: %.1f MB pooled vs %.1f MB unaliased\n", stats.pool_bytes / 1048576.0, stats.unaliased_bytes / 1048576.0);
+	printf("textures created after the first frame: %d\n", stats.n_texture_creations - warm.n_texture_creations);
+	printf("cpu (build+execute+submit): %.1f us/frame\n", (double)build_us / n_frames);
+
+	// per-pass times of the latest frame the profiler has results for
+	struct gpudl_gpu_profile profile;
+	if (gpudl_get_gpu_profile(&profile)) {
+		printf("frame %llu (%s):\n", (unsigned long long)profile.frame, profile.has_gpu_times ? "gpu timestamps" : "no timestamp queries; cpu only");
+		for (int i = 0; i < profile.n_scopes; i++) {
+			const struct gpudl_gpu_scope* scope = &profile.scopes[i];
+			printf("  %*s%-12s gpu %8.3f ms  cpu %8.3f ms\n", scope->depth*2, "", scope->name, scope->gpu_ms, scope->cpu_ms);
+		}
+	}
+
+	gpudl_shutdown();
+	return EXIT_SUCCESS;
+}
+
+static const struct {
+	const char* name;
+	const char* args;
+	const char* description;
+	int(*fn)(int argc, char** argv);
+} benchmarks[] = {
+	{ "pool", "[n=50]", "open-to-first-present latency, window pool off/on", bench_pool },
+	{ "churn", "[n=10000] [reinits=20]", "open/render/close windows, then shutdown/init cycles; fails if RSS or GPU memory grows", bench_churn },
+	{ "2d", "[n=100000] [frames=200]", "2d layer primitives per second, with interleaved state changes", bench_2d },
+	{ "stream", "[n=16] [size=2048] [budget_mb=8]", "texture streaming throughput and frame times while streaming", bench_stream },
+	{ "bundle", "[draws=10000] [frames=100]", "CPU encode time of a static draw stream, direct vs render bundle", bench_bundle },
+	{ "graph", "[frames=200]", "frame graph post chain: culling, transient texture VRAM, per-pass times", bench_graph },
+};
+
+int main(int argc, char** argv)
+{
+	const int n_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <benchmark> [args]\n", argv[0]);
+		for (int i = 0; i < n_benchmarks; i++) {
+			fprintf(stderr, "  %-8s %-32s %s\n", benchmarks[i].name, benchmarks[i].args, benchmarks[i].description);
+		}
+		return EXIT_FAILURE;
+	}
+	for (int i = 0; i < n_benchmarks; i++) {
+		if (strcmp(argv[1], benchmarks[i].name) != 0) continue;
+		gpudl_init();
+		return benchmarks[i].fn(argc-2, argv+2);
+	}
+	fprintf(stderr, "no such benchmark: %s\n", argv[1]);
+	return EXIT_FAILURE;
+}
@@ -104,15 +104,38 @@ static void write_vertices(int iteration, int n_triangles, struct Vertex* vertic
 	}
 }
 
+// the draw stream is the same in every window and frame, save for the bind
+// group and its dynamic offset, so it's recorded into a render bundle with
+// those as the variant
+struct scene {
+	WGPURenderPipeline pipeline;
+	WGPUBuffer vtxbuf;
+	size_t vtxbuf_sz;
+	int n_vertices;
+};
+
+static void record_scene(WGPURenderBundleEncoder encoder, const uint64_t* variant, int n_variant, void* userdata)
+{
+	struct scene* scene = userdata;
+	const uint32_t uniforms_offset = variant[1];
+	wgpuRenderBundleEncoderSetPipeline(encoder, scene->pipeline);
+	wgpuRenderBundleEncoderSetBindGroup(encoder, 0, (WGPUBindGroup)(uintptr_t)variant[0], 1, &uniforms_offset);
+	wgpuRenderBundleEncoderSetVertexBuffer(encoder, 0, scene->vtxbuf, 0, scene->vtxbuf_sz);
+	wgpuRenderBundleEncoderDraw(encoder, scene->n_vertices, 1, 0, 0);
+}
+
 struct window {
 	int id;
 	int mx;
 	int my;
+	int fullscreen;
 };
 
 int main(int argc, char** argv)
 {
 	gpudl_init();
+	// don't let the CPU queue up more than two frames ahead of the GPU
+	gpudl_set_frames_in_flight(2, GPUDL_FRAME_WAIT_BLOCK);
 	//wgpuCreateInstance(NULL);
 
 	struct window* windows = NULL;
@@ -180,12 +203,6 @@ int main(int argc, char** argv)
 	});
 	assert(vtxbuf);
 
-	WGPUBuffer unibuf = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
-		.usage = WGPUBufferUsage_Uniform /*| WGPUBufferUsage_MapWrite*/ | WGPUBufferUsage_CopyDst,
-		.size = sizeof(struct Uniforms),
-	});
-	assert(unibuf);
-
 	const int texture_width = 256;
 	const int texture_height = 256;
 	const size_t texture_sz = texture_width * texture_height;
@@ -237,7 +254,7 @@ int main(int argc, char** argv)
 
 	//wgpuDeviceCreateSampler
 
-	WGPUBindGroupLayout bind_group_layout = wgpuDeviceCreateBindGroupLayout(device, &((WGPUBindGroupLayoutDescriptor){
+	WGPUBindGroupLayout bind_group_layout = gpudl_get_bind_group_layout(&((WGPUBindGroupLayoutDescriptor){
 		.entryCount = 2,
 		.entries = (WGPUBindGroupLayoutEntry[]){
 			(WGPUBindGroupLayoutEntry){
@@ -246,7 +263,7 @@ int main(int argc, char** argv)
 				.buffer = (WGPUBufferBindingLayout){
 					.type = WGPUBufferBindingType_Uniform,
 					//.type = WGPUBufferBindingType_Storage,
-					.hasDynamicOffset = false,
+					.hasDynamicOffset = true,
 					.minBindingSize = sizeof(struct Uniforms),
 				},
 			},
@@ -277,22 +294,26 @@ int main(int argc, char** argv)
 		}
 	);
 
-	WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor){
+	// looked up every frame with gpudl_get_bind_group(); the cache hands
+	// back the same bind group as long as the descriptor doesn't change.
+	// uniforms come from gpudl's uniform ring, whose buffer depends on
+	// the frame slot, so entry 0 is filled in per frame
+	WGPUBindGroupEntry bind_group_entries[] = {
+		(WGPUBindGroupEntry){
+			.binding = 0,
+			.offset = 0,
+			.size = sizeof(struct Uniforms),
+		},
+		(WGPUBindGroupEntry){
+			.binding = 1,
+			.textureView = texture_view,
+		},
+	};
+	const WGPUBindGroupDescriptor bind_group_desc = {
 		.layout = bind_group_layout,
 		.entryCount = 2,
-		.entries = (WGPUBindGroupEntry[]){
-			(WGPUBindGroupEntry){
-				.binding = 0,
-				.buffer = unibuf,
-				.offset = 0,
-				.size = sizeof(struct Uniforms),
-			},
-			(WGPUBindGroupEntry){
-				.binding = 1,
-				.textureView = texture_view,
-			}, 
-		},
-	});
+		.entries = bind_group_entries,
+	};
 
 	WGPUTextureFormat swapChainFormat = wgpuSurfaceGetPreferredFormat(gpudl_window_get_surface(windows[0].id), adapter);
 
@@ -361,6 +382,14 @@ int main(int argc, char** argv)
 		}
 	);
 
+	struct scene scene = {
+		.pipeline = pipeline,
+		.vtxbuf = vtxbuf,
+		.vtxbuf_sz = vtxbuf_sz,
+		.n_vertices = n_vertices,
+	};
+	const int scene_bundle = gpudl_bundle_create(record_scene, &scene);
+
 	int iteration = 0;
 	int exiting = 0;
 
@@ -411,10 +440,18 @@ int main(int argc, char** argv)
 				}
 				break;
 			case GPUDL_KEY:
-				printf("KEY keysym=%d pressed=%d\n", e.key.keysym, e.key.pressed);
+				printf("KEY keysym=%d pressed=%d repeat=%d\n", e.key.keysym, e.key.pressed, e.key.repeat);
 				if (e.key.keysym == '\033' && e.key.pressed) {
 					do_close_window_id = e.window_id;
 				}
+				if (e.key.keysym == 'f' && e.key.pressed && !e.key.repeat) {
+					for (int i = 0; i < arrlen(windows); i++) {
+						struct window* window = &windows[i];
+						if (window->id != e.window_id) continue;
+						window->fullscreen = !window->fullscreen;
+						gpudl_window_set_fullscreen(window->id, window->fullscreen ? GPUDL_FULLSCREEN_BYPASS_COMPOSITOR : GPUDL_WINDOWED);
+					}
+				}
 				break;
 			case GPUDL_ENTER:
 				printf("ENTER\n");
@@ -428,6 +465,12 @@ int main(int argc, char** argv)
 			case GPUDL_UNFOCUS:
 				printf("-FOCUS\n");
 				break;
+			case GPUDL_VISIBILITY:
+				printf("VISIBLE=%d\n", e.visibility.visible);
+				break;
+			case GPUDL_REDRAW:
+				// the demo animates, so it redraws every frame anyway
+				break;
 			}
 
 			if (do_close_window_id) {
@@ -447,7 +490,8 @@ int main(int argc, char** argv)
 
 			WGPUTextureView next_texture = gpudl_render_begin(window->id);
 			if (!next_texture) {
-				fprintf(stderr, "WARNING: no swap chain texture view\n");
+				// not ready for a new frame (no swap chain yet,
+				// or, on wayland, waiting for a frame callback)
 				continue;
 			}
 
@@ -458,6 +502,13 @@ int main(int argc, char** argv)
 			int width, height;
 			gpudl_window_get_size(window->id, &width, &height);
 
+			// late-latch; events may be a frame behind
+			float px, py;
+			if (gpudl_get_latest_pointer(window->id, &px, &py)) {
+				window->mx = px;
+				window->my = py;
+			}
+
 			if (window->my > height/2) {
 				gpudl_set_cursor(my_cursor);
 			} else if (window->mx < width/2) {
@@ -466,12 +517,15 @@ int main(int argc, char** argv)
 				gpudl_set_cursor(GPUDL_CURSOR_HAND);
 			}
 
-			struct Uniforms u = {
+			uint32_t uniforms_offset;
+			struct Uniforms* u = gpudl_alloc_uniforms(sizeof *u, &uniforms_offset);
+			*u = (struct Uniforms){
 				.frame = iteration,
 				.distort = (((float)window->my / (float)height) - 0.5f) * 2.5f,
 				.alpha = ((float)window->mx / (float)width) * 5.0f,
 			};
-			wgpuQueueWriteBuffer(queue, unibuf, 0, &u, sizeof u);
+			gpudl_upload_uniforms();
+			bind_group_entries[0].buffer = gpudl_get_uniform_buffer();
 
 			WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(
 				device,
@@ -493,10 +547,11 @@ int main(int argc, char** argv)
 				}
 			);
 
-			wgpuRenderPassEncoderSetPipeline(renderPass, pipeline);
-			wgpuRenderPassEncoderSetBindGroup(renderPass, 0, bind_group, 0, 0);
-			wgpuRenderPassEncoderSetVertexBuffer(renderPass, 0, vtxbuf, 0, vtxbuf_sz);
-			wgpuRenderPassEncoderDraw(renderPass, n_vertices, 1, 0, 0);
+			const uint64_t variant[] = {
+				(uintptr_t)gpudl_get_bind_group(&bind_group_desc),
+				uniforms_offset,
+			};
+			gpudl_bundle_execute(scene_bundle, renderPass, variant, 2);
 			wgpuRenderPassEncoderEnd(renderPass);
 
 			WGPUCommandBuffer cmdBuffer = wgpuCommandEncoderFinish(
@@ -511,6 +566,8 @@ int main(int argc, char** argv)
 		iteration++;
 	}
 
+	gpudl_shutdown();
+
 	return EXIT_SUCCESS;
 }
 
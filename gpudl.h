@@ -7,6 +7,63 @@
 #endif
 #define GPUDL_MAX_CURSORS (1 << (GPUDL_MAX_CURSORS_LOG2))
 
+// sleeping is imprecise, so the frame limiter (gpudl_set_target_fps()) wakes
+// up this many microseconds early and spin-waits the remainder
+#ifndef GPUDL_FRAME_LIMITER_SPIN_US
+#define GPUDL_FRAME_LIMITER_SPIN_US (1000)
+#endif
+
+// number of 1ms buckets in struct gpudl_latency_histogram
+#ifndef GPUDL_LATENCY_HISTOGRAM_BUCKETS
+#define GPUDL_LATENCY_HISTOGRAM_BUCKETS (64)
+#endif
+
+// upper limit for gpudl_set_frames_in_flight()
+#ifndef GPUDL_MAX_FRAMES_IN_FLIGHT
+#define GPUDL_MAX_FRAMES_IN_FLIGHT (8)
+#endif
+
+// bind groups from gpudl_get_bind_group() that haven't been used for this
+// many frames are dropped
+#ifndef GPUDL_BIND_GROUP_CACHE_MAX_AGE
+#define GPUDL_BIND_GROUP_CACHE_MAX_AGE (120)
+#endif
+
+// default size of each frame slot's buffer in the uniform ring; see
+// gpudl_alloc_uniforms()
+#ifndef GPUDL_UNIFORM_RING_SIZE
+#define GPUDL_UNIFORM_RING_SIZE (1<<20)
+#endif
+
+// streamed textures (gpudl_stream_texture()): max number of them, how many
+// bytes are uploaded per frame by default, and up to which size mips are
+// made on the worker thread and uploaded before the rest
+#ifndef GPUDL_MAX_STREAMED_TEXTURES
+#define GPUDL_MAX_STREAMED_TEXTURES (256)
+#endif
+#ifndef GPUDL_STREAM_UPLOAD_BUDGET
+#define GPUDL_STREAM_UPLOAD_BUDGET (8<<20)
+#endif
+#ifndef GPUDL_STREAM_TAIL_SIZE
+#define GPUDL_STREAM_TAIL_SIZE (64)
+#endif
+
+// pooled frame graph textures (gpudl_graph_create_texture()) that no graph
+// has used for this many frames are destroyed
+#ifndef GPUDL_GRAPH_TEXTURE_MAX_AGE
+#define GPUDL_GRAPH_TEXTURE_MAX_AGE (8)
+#endif
+
+// max gpudl_gpu_scope_begin() calls per frame; further scopes are ignored
+#ifndef GPUDL_GPU_PROFILER_MAX_SCOPES
+#define GPUDL_GPU_PROFILER_MAX_SCOPES (256)
+#endif
+
+// gpudl_upload_file_to_buffer() uploads in chunks of this size
+#ifndef GPUDL_FILE_UPLOAD_CHUNK
+#define GPUDL_FILE_UPLOAD_CHUNK (8<<20)
+#endif
+
 // TODO inline webgpu.h? or is that a bad idea?
 #define WGPU_SKIP_DECLARATIONS
 #include "webgpu.h"
@@ -33,8 +90,23 @@ typedef void (*WGPULogCallback)(WGPULogLevel level, const char *msg);
 typedef void (*WGPUProcTextureDrop)(WGPUTexture);
 typedef void (*WGPUProcTextureViewDrop)(WGPUTextureView);
 typedef void (*WGPUProcBindGroupDrop)(WGPUBindGroup);
+typedef void (*WGPUProcBufferDrop)(WGPUBuffer);
+typedef void (*WGPUProcBindGroupLayoutDrop)(WGPUBindGroupLayout);
+typedef void (*WGPUProcSamplerDrop)(WGPUSampler);
+typedef void (*WGPUProcRenderBundleDrop)(WGPURenderBundle);
+typedef void (*WGPUProcShaderModuleDrop)(WGPUShaderModule);
+typedef void (*WGPUProcPipelineLayoutDrop)(WGPUPipelineLayout);
+typedef void (*WGPUProcComputePipelineDrop)(WGPUComputePipeline);
+typedef void (*WGPUProcRenderPipelineDrop)(WGPURenderPipeline);
 typedef void (*WGPUProcSetLogCallback)(WGPULogCallback callback);
 typedef void (*WGPUProcSetLogLevel)(WGPULogLevel level);
+typedef void (*WGPUProcDeviceDrop)(WGPUDevice);
+typedef void (*WGPUProcAdapterDrop)(WGPUAdapter);
+typedef void (*WGPUProcSurfaceDrop)(WGPUSurface);
+typedef void (*WGPUProcInstanceDrop)(WGPUInstance);
+// invokes pending callbacks (map, submitted-work-done); force_wait=true
+// blocks until all submitted work is done
+typedef void (*WGPUProcDevicePoll)(WGPUDevice device, bool force_wait);
 
 
 // procs defined in libwgpu_native.so; Dawn is currently not considered
@@ -54,6 +126,8 @@ typedef void (*WGPUProcSetLogLevel)(WGPULogLevel level);
 	GPUDL_WGPU_PROC(CommandEncoderCopyTextureToBuffer) \
 	GPUDL_WGPU_PROC(CommandEncoderCopyTextureToTexture) \
 	GPUDL_WGPU_PROC(CommandEncoderFinish) \
+	GPUDL_WGPU_PROC(CommandEncoderResolveQuerySet) \
+	GPUDL_WGPU_PROC(CommandEncoderWriteTimestamp) \
 	GPUDL_WGPU_PROC(ComputePassEncoderDispatchWorkgroups) \
 	GPUDL_WGPU_PROC(ComputePassEncoderDispatchWorkgroupsIndirect) \
 	GPUDL_WGPU_PROC(ComputePassEncoderEnd) \
@@ -65,6 +139,8 @@ typedef void (*WGPUProcSetLogLevel)(WGPULogLevel level);
 	GPUDL_WGPU_PROC(DeviceCreateCommandEncoder) \
 	GPUDL_WGPU_PROC(DeviceCreateComputePipeline) \
 	GPUDL_WGPU_PROC(DeviceCreatePipelineLayout) \
+	GPUDL_WGPU_PROC(DeviceCreateQuerySet) \
+	GPUDL_WGPU_PROC(DeviceCreateRenderBundleEncoder) \
 	GPUDL_WGPU_PROC(DeviceCreateRenderPipeline) \
 	GPUDL_WGPU_PROC(DeviceCreateSampler) \
 	GPUDL_WGPU_PROC(DeviceCreateShaderModule) \
@@ -76,14 +152,26 @@ typedef void (*WGPUProcSetLogLevel)(WGPULogLevel level);
 	GPUDL_WGPU_PROC(DeviceSetUncapturedErrorCallback) \
 	GPUDL_WGPU_PROC(InstanceCreateSurface) \
 	GPUDL_WGPU_PROC(InstanceRequestAdapter) \
+	GPUDL_WGPU_PROC(QuerySetDestroy) \
+	GPUDL_WGPU_PROC(QueueOnSubmittedWorkDone) \
 	GPUDL_WGPU_PROC(QueueSubmit) \
 	GPUDL_WGPU_PROC(QueueWriteBuffer) \
 	GPUDL_WGPU_PROC(QueueWriteTexture) \
+	GPUDL_WGPU_PROC(RenderBundleEncoderDraw) \
+	GPUDL_WGPU_PROC(RenderBundleEncoderDrawIndexed) \
+	GPUDL_WGPU_PROC(RenderBundleEncoderDrawIndexedIndirect) \
+	GPUDL_WGPU_PROC(RenderBundleEncoderDrawIndirect) \
+	GPUDL_WGPU_PROC(RenderBundleEncoderFinish) \
+	GPUDL_WGPU_PROC(RenderBundleEncoderSetBindGroup) \
+	GPUDL_WGPU_PROC(RenderBundleEncoderSetIndexBuffer) \
+	GPUDL_WGPU_PROC(RenderBundleEncoderSetPipeline) \
+	GPUDL_WGPU_PROC(RenderBundleEncoderSetVertexBuffer) \
 	GPUDL_WGPU_PROC(RenderPassEncoderDraw) \
 	GPUDL_WGPU_PROC(RenderPassEncoderDrawIndexed) \
 	GPUDL_WGPU_PROC(RenderPassEncoderDrawIndexedIndirect) \
 	GPUDL_WGPU_PROC(RenderPassEncoderDrawIndirect) \
 	GPUDL_WGPU_PROC(RenderPassEncoderEnd) \
+	GPUDL_WGPU_PROC(RenderPassEncoderExecuteBundles) \
 	GPUDL_WGPU_PROC(RenderPassEncoderSetBindGroup) \
 	GPUDL_WGPU_PROC(RenderPassEncoderSetBlendConstant) \
 	GPUDL_WGPU_PROC(RenderPassEncoderSetIndexBuffer) \
@@ -100,11 +188,30 @@ typedef void (*WGPUProcSetLogLevel)(WGPULogLevel level);
 	GPUDL_WGPU_PROC(TextureDrop) \
 	GPUDL_WGPU_PROC(TextureViewDrop) \
 	GPUDL_WGPU_PROC(BindGroupDrop) \
+	GPUDL_WGPU_PROC(DevicePoll) \
 	GPUDL_WGPU_PROC(SetLogCallback) \
 	GPUDL_WGPU_PROC(SetLogLevel)
 
+// procs that come and go between wgpu-native versions; NULL if missing, so
+// check before calling
+#define GPUDL_WGPU_OPTIONAL_PROCS \
+	GPUDL_WGPU_PROC(AdapterDrop) \
+	GPUDL_WGPU_PROC(AdapterHasFeature) \
+	GPUDL_WGPU_PROC(BindGroupLayoutDrop) \
+	GPUDL_WGPU_PROC(BufferDrop) \
+	GPUDL_WGPU_PROC(ComputePipelineDrop) \
+	GPUDL_WGPU_PROC(DeviceDrop) \
+	GPUDL_WGPU_PROC(InstanceDrop) \
+	GPUDL_WGPU_PROC(PipelineLayoutDrop) \
+	GPUDL_WGPU_PROC(RenderBundleDrop) \
+	GPUDL_WGPU_PROC(RenderPipelineDrop) \
+	GPUDL_WGPU_PROC(SamplerDrop) \
+	GPUDL_WGPU_PROC(ShaderModuleDrop) \
+	GPUDL_WGPU_PROC(SurfaceDrop)
+
 #define GPUDL_WGPU_PROC(NAME) extern WGPUProc##NAME wgpu##NAME;
 GPUDL_WGPU_PROCS
+GPUDL_WGPU_OPTIONAL_PROCS
 #undef GPUDL_WGPU_PROC
 
 enum gpudl_button {
@@ -125,6 +232,11 @@ enum gpudl_event_type {
 	GPUDL_LEAVE,
 	GPUDL_FOCUS,
 	GPUDL_UNFOCUS,
+	GPUDL_VISIBILITY,
+	// window content was damaged (exposed, resized, shown) or invalidated
+	// with gpudl_window_invalidate(); pending redraws are coalesced, so
+	// there's at most one per window between renders
+	GPUDL_REDRAW,
 };
 
 enum gpudl_system_cursor {
@@ -201,69 +313,827 @@ struct gpudl_event_button {
 //    always zero for release events (pressed==0)
 struct gpudl_event_key {
 	int pressed;
+	int repeat; // auto-repeat of a held key; pressed=1, and no releases in between
 	int keysym;
 	int codepoint;
 };
 
+// sent when a window becomes visible or hidden. a window is hidden while it's
+// unmapped (e.g. minimized) or fully obscured by other windows
+struct gpudl_event_visibility {
+	int visible;
+};
+
 struct gpudl_event {
 	int window_id;
 	enum gpudl_event_type type;
+	// server timestamp in milliseconds of input events (motion, button,
+	// key, enter/leave on X11); 0 if the event has none. the base is
+	// server defined, but it's usually CLOCK_MONOTONIC
+	uint32_t time;
+	// when gpudl read the event from the display connection, in
+	// gpudl_time_us() microseconds
+	uint64_t receive_us;
 	union {
-		struct gpudl_event_motion motion;
-		struct gpudl_event_button button;
-		struct gpudl_event_key    key;
+		struct gpudl_event_motion     motion;
+		struct gpudl_event_button     button;
+		struct gpudl_event_key        key;
+		struct gpudl_event_visibility visibility;
 	};
 };
 
+// how gpudl_render_begin() treats windows that don't need full frame rates;
+// all zeroes (the default) means: hidden windows get no frames at all
+// (gpudl_render_begin() returns NULL), unfocused windows are not throttled
+struct gpudl_throttle_policy {
+	int hidden_fps;    // fps for hidden windows instead of none
+	int unfocused_fps; // fps cap for visible windows without keyboard focus
+};
+
+// frame pacing statistics, collected by gpudl_render_begin(); all times in
+// microseconds
+struct gpudl_frame_stats {
+	int      n_frames;           // frames since last reset
+	double   interval_mean;      // time between gpudl_render_begin() calls...
+	double   interval_stddev;    // ...and its jitter
+	uint64_t interval_min;
+	uint64_t interval_max;
+	double   lateness_mean;      // how late frames started compared to the
+	uint64_t lateness_max;       // gpudl_set_target_fps() schedule
+	// how presented frames reached the screen (X11 Present only): flips
+	// are scanned out directly, i.e. the compositor was bypassed;
+	// copies went through the compositor or a blit
+	int      n_flips;
+	int      n_copies;
+};
+
+struct gpudl_object_cache_stats {
+	int n_hits;
+	int n_misses;
+	int n_evictions;
+	int n_entries; // currently cached
+};
+
+enum gpudl_2d_blend {
+	GPUDL_2D_BLEND_ALPHA = 0,
+	GPUDL_2D_BLEND_ADD,
+	GPUDL_2D_BLEND_END
+};
+
+struct gpudl_2d_stats {
+	int n_primitives;
+	int n_commands; // runs of primitives with the same state, as drawn
+	int n_draws;    // ...after sorting and merging
+	int n_flushes;
+};
+
+// where an image is in an atlas; view is a 2D view of the layer, usable with
+// gpudl_2d_set_texture()
+struct gpudl_atlas_rect {
+	int             layer;
+	WGPUTextureView view;
+	float           u0, v0, u1, v1;
+};
+
+struct gpudl_atlas_stats {
+	int      n_entries;
+	int      n_hits;
+	int      n_misses;
+	int      n_evictions; // of shelves (or whole layers)
+	int      n_uploads;
+	uint64_t upload_bytes;
+};
+
+struct gpudl_graph_texture_desc {
+	int width, height; // 0=size passed to gpudl_graph_begin()
+	WGPUTextureFormat format;
+	// RenderAttachment|TextureBinding is implied
+	WGPUTextureUsageFlags usage;
+};
+
+struct gpudl_gpu_scope {
+	const char* name;
+	int    parent; // index of the enclosing scope, or -1
+	int    depth;
+	double gpu_ms; // -1 without timestamp queries; see gpudl_set_gpu_timestamp_period()
+	double cpu_ms; // between gpudl_gpu_scope_begin()/end() calls
+};
+
+struct gpudl_gpu_profile {
+	uint64_t frame;
+	int      has_gpu_times;
+	int      n_scopes;
+	// in begin order, so parents come before their children
+	const struct gpudl_gpu_scope* scopes;
+};
+
+// of the last gpudl_graph_execute()
+struct gpudl_graph_stats {
+	int      n_passes;
+	int      n_culled;
+	int      n_transient; // textures used by live passes
+	int      n_pooled;    // textures backing them (and recent frames')
+	int      n_texture_creations; // since startup
+	uint64_t pool_bytes;
+	uint64_t unaliased_bytes; // what the transient textures would take without aliasing
+};
+
+// read-only file mapping; see gpudl_map_file()
+struct gpudl_mapped_file {
+	const uint8_t* data; // NULL for empty files
+	size_t         size;
+};
+
+// what gpudl_render_begin() does when all frames are in flight
+enum gpudl_frame_wait {
+	GPUDL_FRAME_WAIT_BLOCK = 0, // waits for the GPU to finish (XXX all frames in flight; wgpu-native can't wait for one submission)
+	GPUDL_FRAME_WAIT_SKIP,      // returns NULL
+};
+
+enum gpudl_fullscreen_mode {
+	GPUDL_WINDOWED = 0,
+	GPUDL_FULLSCREEN,
+	// also asks the compositor to unredirect the window so frames can be
+	// flipped directly to the screen (check gpudl_frame_stats.n_flips)
+	GPUDL_FULLSCREEN_BYPASS_COMPOSITOR,
+};
+
+// input-to-photon latency: time from an input event (motion, button or key)
+// until the first frame rendered after it was presented. the input time is
+// the event's server timestamp when that's on CLOCK_MONOTONIC (otherwise the
+// receive time, which misses the time spent in the server), and the present
+// time comes from X11 Present completion events or, on wayland, frame
+// callbacks. without those (no Present extension) nothing is recorded
+struct gpudl_latency_histogram {
+	// buckets[i] counts latencies in [i;i+1) milliseconds; the last bucket
+	// also counts everything above
+	uint32_t buckets[GPUDL_LATENCY_HISTOGRAM_BUCKETS];
+	uint32_t n_samples;
+	uint64_t sum_us;
+	uint64_t max_us;
+};
+
+// timing of the most recently presented frame of a window; times are in
+// microseconds of CLOCK_MONOTONIC, i.e. the same clock as gpudl_time_us()
+struct gpudl_present_timing {
+	uint64_t ust;                 // when the last frame hit the screen
+	uint64_t msc;                 // vblank counter at that time (wayland: counts frame callbacks)
+	uint64_t refresh_interval_us; // estimated vblank period (wayland: of the output's current mode); 0 if not known yet
+	uint64_t next_vblank_ust;     // predicted time of the next vblank after "now"
+};
+
+// classes of events a window can opt out of with
+// gpudl_window_desc.disabled_events. on X11 disabled events are never
+// selected, so the server doesn't send them at all (except focus changes,
+// which are always tracked for the unfocused fps cap but not delivered)
+enum gpudl_event_class {
+	GPUDL_EVENTS_POINTER  = 1<<0, // GPUDL_MOTION, GPUDL_BUTTON, GPUDL_ENTER, GPUDL_LEAVE
+	GPUDL_EVENTS_KEYBOARD = 1<<1, // GPUDL_KEY, GPUDL_FOCUS, GPUDL_UNFOCUS
+	GPUDL_EVENTS_WINDOW   = 1<<2, // GPUDL_VISIBILITY (obscured windows), and Expose-triggered GPUDL_REDRAW
+};
+
+enum gpudl_present_mode {
+	GPUDL_PRESENT_DEFAULT = 0, // currently FIFO
+	GPUDL_PRESENT_FIFO,        // vsync
+	GPUDL_PRESENT_MAILBOX,     // vsync, but newest frame wins; no blocking
+	GPUDL_PRESENT_IMMEDIATE,   // no vsync; may tear
+};
+
+// zero-initialize and set what you need; zero means "default" everywhere
+struct gpudl_window_desc {
+	const char* title;
+	int width, height; // 0: 256×256
+	// initial position; only with position_set=1 (otherwise the window
+	// manager decides). ignored on wayland, where clients can't position
+	// toplevels
+	int x, y;
+	int position_set;
+	enum gpudl_present_mode present_mode;
+	// don't show the window until its first frame is presented, so that
+	// it never appears blank (this is always the case on wayland). on X11
+	// the window is mapped but kept transparent with
+	// _NET_WM_WINDOW_OPACITY, which needs a compositor
+	int hidden_until_first_frame;
+	unsigned    disabled_events; // gpudl_event_class bits
+	// no input method: key events still have codepoints, but without
+	// composition/dead keys, and only for latin-1 (X11)
+	int         no_input_method;
+};
+
 void gpudl_init();
+// closes all windows and releases everything gpudl_init() and friends
+// acquired, including the wgpu device; gpudl_init() may be called again
+void gpudl_shutdown(void);
 void gpudl_set_required_limits(WGPULimits* limits);
 int gpudl_window_open(const char* title);
+int gpudl_window_open_ex(const struct gpudl_window_desc* desc);
+void gpudl_window_set_present_mode(int window_id, enum gpudl_present_mode mode);
 WGPUSurface gpudl_window_get_surface(int window_id);
 void gpudl_window_get_size(int window_id, int* width, int* height);
 void gpudl_window_close(int window_id);
+// keeps up to n withdrawn width×height windows around, with surfaces and
+// swap chains ready, so that opening a window is mostly a matter of mapping
+// one. closed windows are recycled into the pool (otherwise
+// gpudl_window_close() creates one in their place). only windowed (not
+// fullscreen) windows with the default event classes and input method are
+// pooled. X11 only; does nothing on wayland
+void gpudl_set_window_pool(int n, int width, int height);
+// creates windows until the pool is full again after gpudl_window_open()
+// took some; each costs a window, surface and swap chain, so call it when a
+// hitch doesn't matter
+void gpudl_refill_window_pool(void);
 void gpudl_get_wgpu(WGPUInstance* instance, WGPUAdapter* adapter, WGPUDevice* device, WGPUQueue* queue);
 int gpudl_poll_event(struct gpudl_event* e);
+// like gpudl_poll_event(), but blocks for up to timeout_ms milliseconds
+// (-1=forever) waiting for an event; returns 0 on timeout
+int gpudl_wait_event(struct gpudl_event* e, int timeout_ms);
+// makes gpudl emit a GPUDL_REDRAW event for the window
+void gpudl_window_invalidate(int window_id);
+// gets the most recent pointer position in a window, including motion that
+// has arrived but not been returned by gpudl_poll_event() yet (those events
+// are left in the queue). meant to be called as late as possible, e.g. right
+// before uploading uniforms that depend on it. returns 0 if the position
+// isn't known (pointer hasn't been in the window)
+int gpudl_get_latest_pointer(int window_id, float* x, float* y);
 WGPUTextureView gpudl_render_begin(int window_id);
 void gpudl_render_end(void);
 WGPUTextureFormat gpudl_get_preferred_swap_chain_texture_format();
 void gpudl_set_cursor(int cursor); // should be called between gpudl_render_begin()/end()
 int gpudl_make_bitmap_cursor(const char* bitmap);
+// pixels are width*height 0xAARRGGBB values (premultiplied alpha)
+int gpudl_make_argb_cursor(int width, int height, const uint32_t* pixels, int hotspot_x, int hotspot_y);
+// releases a cursor made by gpudl_make_*_cursor(); windows showing it fall
+// back to GPUDL_CURSOR_DEFAULT. bitmap cursors are shared between calls with
+// the same bitmap, so each gpudl_make_bitmap_cursor() needs its own free
+void gpudl_free_cursor(int cursor);
 int gpudl_utf8_decode(const char** c0z, int* n);
+uint64_t gpudl_time_us(void);
+// returns 0 if there's no presentation feedback (yet), e.g. if the X server
+// lacks the Present extension
+int gpudl_window_get_present_timing(int window_id, struct gpudl_present_timing* timing);
+// limits how often gpudl_render_begin() hands out a frame for the window; it
+// sleeps (and spin-waits the last GPUDL_FRAME_LIMITER_SPIN_US) if the window
+// is the next one due, otherwise it returns NULL. fps=0 removes the limit
+void gpudl_set_target_fps(int window_id, int fps);
+void gpudl_window_set_fullscreen(int window_id, enum gpudl_fullscreen_mode mode);
+void gpudl_window_get_frame_stats(int window_id, struct gpudl_frame_stats* stats);
+void gpudl_window_reset_frame_stats(int window_id);
+void gpudl_window_get_latency_histogram(int window_id, struct gpudl_latency_histogram* histogram);
+void gpudl_window_reset_latency_histogram(int window_id);
+int gpudl_window_is_visible(int window_id);
+void gpudl_set_throttle_policy(const struct gpudl_throttle_policy* policy);
+// bounds how far the CPU can get ahead of the GPU. a frame is one round of
+// the application's loop: it has the presents of every window rendered in
+// it, and ends when a window that already presented in it calls
+// gpudl_render_begin() again. it's in flight until the GPU has finished
+// everything submitted before its last gpudl_render_end().
+// with n frames in flight, gpudl_render_begin() blocks or returns NULL as
+// `wait` says. n=0 (the default) turns tracking off. waits for frames in
+// flight before changing n
+void gpudl_set_frames_in_flight(int n, enum gpudl_frame_wait wait);
+// slot in [0;n) of the frame being rendered (always 0 when tracking is off).
+// the GPU is done with the previous frame in the same slot, so per-slot
+// buffers etc. can be overwritten without stalling or racing it
+int gpudl_get_frame_slot(void);
+// number of frames submitted but not yet finished by the GPU
+int gpudl_get_n_frames_in_flight(void);
+// deduplicating object caches, keyed on descriptor contents (labels aside)
+// and the identities of the objects they reference. returned objects belong
+// to the cache; don't drop them. samplers and layouts are kept until
+// gpudl_shutdown(); bind groups are dropped after going unused for
+// GPUDL_BIND_GROUP_CACHE_MAX_AGE frames
+WGPUSampler gpudl_get_sampler(const WGPUSamplerDescriptor* desc);
+WGPUBindGroupLayout gpudl_get_bind_group_layout(const WGPUBindGroupLayoutDescriptor* desc);
+WGPUBindGroup gpudl_get_bind_group(const WGPUBindGroupDescriptor* desc);
+// drops cached bind groups referencing a buffer, sampler or texture view;
+// call it before releasing one, otherwise a new object at the same address
+// could hit a stale bind group
+void gpudl_forget_bind_groups_using(const void* resource);
+// any of the pointers may be NULL
+void gpudl_get_object_cache_stats(struct gpudl_object_cache_stats* samplers, struct gpudl_object_cache_stats* bind_group_layouts, struct gpudl_object_cache_stats* bind_groups);
+// render bundles for draw streams that don't change between frames. the
+// record callback encodes the stream once (targeting the swap chain format
+// without depth/stencil), and gpudl_bundle_execute() replays the recording
+// in any window's render pass. a bundle doesn't inherit pass state, so it
+// must set its own pipeline, bind groups and buffers; whatever varies
+// between replays (e.g. the uniform ring buffer and dynamic offset) goes in
+// the variant words, and each distinct variant gets its own recording.
+// recordings unused for GPUDL_BIND_GROUP_CACHE_MAX_AGE frames are dropped
+typedef void (*gpudl_record_bundle_func)(WGPURenderBundleEncoder encoder, const uint64_t* variant, int n_variant, void* userdata);
+int gpudl_bundle_create(gpudl_record_bundle_func record, void* userdata);
+void gpudl_bundle_execute(int bundle, WGPURenderPassEncoder pass, const uint64_t* variant, int n_variant);
+// drops all recordings; call it when something the record callback uses
+// (but that isn't in the variant) changes
+void gpudl_bundle_invalidate(int bundle);
+void gpudl_bundle_destroy(int bundle);
+// hits are replays, misses are recordings
+void gpudl_get_bundle_stats(struct gpudl_object_cache_stats* stats);
+// uniform ring: each frame slot (see gpudl_get_frame_slot()) has one big
+// uniform buffer which gpudl_alloc_uniforms() sub-allocates from at
+// minUniformBufferOffsetAlignment. fill in the returned memory, bind
+// gpudl_get_uniform_buffer() with hasDynamicOffset=true and pass the
+// dynamic offset to Set*BindGroup(), then call gpudl_upload_uniforms() once
+// before wgpuQueueSubmit() to write everything in one go. allocations are
+// only valid between gpudl_render_begin()/end(); running out of space
+// aborts
+void gpudl_set_uniform_ring_size(size_t size); // bytes per slot; default GPUDL_UNIFORM_RING_SIZE
+void* gpudl_alloc_uniforms(size_t size, uint32_t* dynamic_offset);
+WGPUBuffer gpudl_get_uniform_buffer(void);
+void gpudl_upload_uniforms(void);
+// decodes an image; called on the streaming worker thread. returns
+// width*height RGBA8 pixels allocated with malloc() (gpudl frees them), or
+// NULL on failure
+typedef uint8_t* (*gpudl_decode_func)(void* userdata, int* width, int* height);
+// streams a texture in the background: decode() runs on a worker thread,
+// which also makes the small mips (GPUDL_STREAM_TAIL_SIZE and below).
+// gpudl_pump_streamed_textures() uploads those first, then the base mip
+// through staging buffers, a budget's worth per call, and finally fills in
+// the mips between with a compute pass. returns a handle
+int gpudl_stream_texture(gpudl_decode_func decode, void* userdata);
+// returns a view of the resident mips (NULL if none yet); *resident_mip is
+// the largest resident mip: 0 when fully loaded, -1 if nothing is resident
+// yet, -2 if decoding failed. the view changes as more becomes resident,
+// so get it every frame (gpudl_get_bind_group() takes care of bind groups)
+WGPUTextureView gpudl_get_streamed_texture(int handle, int* resident_mip);
+void gpudl_free_streamed_texture(int handle);
+void gpudl_set_stream_upload_budget(size_t bytes_per_frame); // 0=GPUDL_STREAM_UPLOAD_BUDGET
+// called by gpudl_render_begin() once per application frame (see
+// gpudl_set_frames_in_flight()), however many windows render in it; call it
+// yourself if you're not rendering (e.g. on a loading screen that doesn't
+// redraw). each call spends the whole budget
+void gpudl_pump_streamed_textures(void);
+// maps a whole file read-only with sequential access hints; returns 0 (and
+// complains on stderr) on failure
+int gpudl_map_file(const char* path, struct gpudl_mapped_file* file);
+void gpudl_unmap_file(struct gpudl_mapped_file* file);
+// starts reading a range into the page cache in the background
+void gpudl_prefetch_file(const struct gpudl_mapped_file* file, size_t offset, size_t size);
+// writes a range of the file into a buffer without staging it on the heap
+// first; size and buffer_offset must be multiples of 4. submits as it goes
+// and blocks on the GPU so that at most 2*GPUDL_FILE_UPLOAD_CHUNK bytes are
+// staged at a time
+void gpudl_upload_file_to_buffer(const struct gpudl_mapped_file* file, size_t offset, size_t size, WGPUBuffer buffer, uint64_t buffer_offset);
+// returns NULL if the file can't be read
+WGPUShaderModule gpudl_load_wgsl(const char* path);
+// immediate-mode 2D drawing into the window being rendered; coordinates are
+// in window pixels, colors are 0xAARRGGBB (not premultiplied). everything
+// drawn between gpudl_render_begin() and gpudl_2d_flush() goes into one
+// vertex stream for the window, sorted by layer, then blend mode, then
+// texture, so that runs with the same state become a single draw. within a
+// layer, primitives are only kept in order if their state is the same, so
+// put overlapping primitives that need ordering in separate layers. state
+// (layer, blend, texture) is reset by gpudl_render_begin()
+void gpudl_2d_set_layer(int layer); // 0..65535
+void gpudl_2d_set_blend(enum gpudl_2d_blend blend);
+void gpudl_2d_set_texture(WGPUTextureView texture); // NULL=untextured; must be filterable float
+void gpudl_2d_rect(float x, float y, float w, float h, uint32_t argb);
+void gpudl_2d_textured_rect(float x, float y, float w, float h, float u0, float v0, float u1, float v1, uint32_t argb);
+void gpudl_2d_line(float x0, float y0, float x1, float y1, float width, uint32_t argb);
+void gpudl_2d_triangle(float x0, float y0, float x1, float y1, float x2, float y2, uint32_t argb);
+// records a render pass drawing everything into target, whose format is
+// `format` (WGPUTextureFormat_Undefined=the swap chain's); clear=NULL keeps
+// what's there. can be called several times per frame (e.g. for an
+// offscreen target, then the swap chain)
+void gpudl_2d_flush(WGPUCommandEncoder encoder, WGPUTextureView target, WGPUTextureFormat format, const WGPUColor* clear);
+void gpudl_2d_get_stats(struct gpudl_2d_stats* stats);
+void gpudl_2d_reset_stats(void);
+// texture atlas: small RGBA8 images packed into the layers of a
+// size×size×n_layers texture array with a shelf packer, so they can share
+// a bind group (one per layer). images are identified by a caller-chosen
+// key. when full, the least recently used shelf is evicted, along with
+// all its images; shelves used in the current frame are never evicted, so
+// rects stay valid until the frame ends
+int gpudl_atlas_create(int size, int n_layers);
+void gpudl_atlas_destroy(int atlas);
+// returns 0 if the image isn't (or no longer) in the atlas
+int gpudl_atlas_lookup(int atlas, uint64_t key, struct gpudl_atlas_rect* rect);
+// adds width*height 0xAARRGGBB pixels (uploading only the new rectangle;
+// stored as RGBA8Unorm, i.e. R,G,B,A bytes, whatever the host byte order).
+// returns 0 if the image is larger than a layer, or everything is in use
+int gpudl_atlas_add(int atlas, uint64_t key, int width, int height, const uint32_t* pixels, struct gpudl_atlas_rect* rect);
+WGPUTextureView gpudl_atlas_get_array_view(int atlas);
+void gpudl_atlas_get_stats(int atlas, struct gpudl_atlas_stats* stats);
+// frame graph: passes declare the textures they read and write, and
+// gpudl_graph_execute() culls passes whose writes nothing reads (unless
+// they write an imported texture, like the backbuffer, or have side
+// effects), gives transient textures memory from a pool for the span of
+// passes using them, so that textures with disjoint lifetimes alias, and
+// records the live passes, in declaration order, into one encoder with one
+// submit (uploading the uniform ring first). resource and pass handles only
+// live until gpudl_graph_execute()
+#define GPUDL_GRAPH_BACKBUFFER (1)
+typedef void (*gpudl_graph_pass_func)(WGPUCommandEncoder encoder, void* userdata);
+void gpudl_graph_begin(WGPUTextureView backbuffer, int width, int height);
+int gpudl_graph_create_texture(const struct gpudl_graph_texture_desc* desc);
+int gpudl_graph_import_texture(WGPUTextureView view);
+int gpudl_graph_add_pass(const char* name, gpudl_graph_pass_func fn, void* userdata);
+// declare these right after adding the pass. a pass that loads a target
+// it draws to should both read and write it
+void gpudl_graph_read(int pass, int resource);
+void gpudl_graph_write(int pass, int resource);
+void gpudl_graph_set_side_effect(int pass); // never culled
+// only valid inside the callbacks of passes using the resource; views of
+// pooled textures are stable, so gpudl_get_bind_group() hits across frames
+WGPUTextureView gpudl_graph_get_view(int resource);
+WGPUTexture gpudl_graph_get_texture(int resource);
+void gpudl_graph_execute(void);
+void gpudl_graph_get_stats(struct gpudl_graph_stats* stats);
+// GPU profiler: scopes bracket commands on an encoder (outside of passes)
+// and may nest; gpudl_graph_execute() puts one around each pass. when the
+// adapter supports timestamp queries, each scope writes a timestamp at
+// either end, and gpudl_render_end() resolves them and reads them back
+// asynchronously; otherwise only CPU times are measured. scope names must
+// outlive the profile
+void gpudl_gpu_scope_begin(WGPUCommandEncoder encoder, const char* name);
+void gpudl_gpu_scope_end(WGPUCommandEncoder encoder, const char* name);
+// gets the latest frame whose results are in (typically a few frames
+// behind); returns 0 if there's none yet. valid until the next call
+int gpudl_get_gpu_profile(struct gpudl_gpu_profile* profile);
+int gpudl_gpu_profiler_has_timestamps(void);
+// timestamps are in device ticks, and wgpu-native doesn't expose the queue's
+// timestamp period (it varies between GPUs and drivers; many Intel and AMD
+// ones don't tick at 1ns), so gpu_ms is only correct once this is set from
+// the driver's reported period (Vulkan's VkPhysicalDeviceLimits::timestampPeriod).
+// default 1, i.e. gpu_ms is in millions of ticks until then
+void gpudl_set_gpu_timestamp_period(float ns_per_tick);
+// like gpudl_stream_texture(), but for width*height raw RGBA8 pixels at
+// offset in a file. the worker maps the file and reads it in while making
+// the small mips, and the base mip goes from the mapping straight into
+// staging buffers
+int gpudl_stream_texture_file(const char* path, size_t offset, int width, int height);
 
 #ifdef GPUDL_IMPLEMENTATION
 
 // std
 #include <assert.h>
+#include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <dlfcn.h>
 #include <locale.h>
-
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef GPUDL_WAYLAND
+#include <wayland-client.h>
+#include <wayland-cursor.h>
+#include <xkbcommon/xkbcommon.h>
+// generate with:
+//   wayland-scanner client-header /usr/share/wayland-protocols/stable/xdg-shell/xdg-shell.xml xdg-shell-client-protocol.h
+// (and link with the corresponding `wayland-scanner private-code` output;
+// see demo/Makefile)
+#include "xdg-shell-client-protocol.h"
+#else
 #include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+#include <X11/XKBlib.h>
 #include <X11/keysym.h>
 #include <X11/cursorfont.h>
+#include <X11/extensions/Xpresent.h>
+#include <X11/extensions/sync.h>
+#include <X11/Xcursor/Xcursor.h>
+#endif
 
 #define GPUDL__MAX_WINDOWS (256)
+#define GPUDL__MAX_QUEUED_EVENTS (256)
+#define GPUDL__WL_MAX_OUTPUTS (16)
 
 #define GPUDL_WGPU_PROC(NAME) WGPUProc##NAME wgpu##NAME;
 GPUDL_WGPU_PROCS
+GPUDL_WGPU_OPTIONAL_PROCS
 #undef GPUDL_WGPU_PROC
 
+#define GPUDL__MAX_FRAMES_AWAITING_PRESENT (8)
+
+enum {
+	GPUDL__STREAM_FREE = 0,
+	GPUDL__STREAM_QUEUED,
+	GPUDL__STREAM_DECODING,  // owned by the worker
+	GPUDL__STREAM_DECODED,
+	GPUDL__STREAM_UPLOADING, // tail resident, base mip partially uploaded
+	GPUDL__STREAM_DONE,
+	GPUDL__STREAM_FAILED,
+	GPUDL__STREAM_FREEING,   // being released by gpudl_free_streamed_texture()
+};
+
+struct gpudl__2d_vertex {
+	float    x, y;
+	float    u, v;
+	uint32_t argb;
+};
+
+struct gpudl__2d_command {
+	uint32_t key; // see GPUDL__2D_KEY()
+	int      seq;
+	int      first_vertex;
+	int      n_vertices;
+};
+
+#define GPUDL__2D_MAX_FORMATS (8)
+
+// the blend mode pipelines for one target format
+struct gpudl__2d_pipelines {
+	WGPUTextureFormat  format;
+	WGPURenderPipeline pipelines[GPUDL_2D_BLEND_END];
+};
+
+struct gpudl__2d {
+	int                 layer;
+	enum gpudl_2d_blend blend;
+	WGPUTextureView     texture_view;
+	int                 texture; // index in textures (+1); -1=not looked up yet
+
+	int n_vertices, cap_vertices;
+	struct gpudl__2d_vertex* vertices; // as drawn
+	int cap_sorted;
+	struct gpudl__2d_vertex* sorted;   // as uploaded
+	int n_commands, cap_commands;
+	struct gpudl__2d_command* commands;
+	int n_textures, cap_textures;
+	WGPUTextureView* textures;
+
+	struct gpudl_2d_stats stats;
+
+	WGPUTexture         white_texture;
+	WGPUTextureView     white_view;
+	WGPUSampler         sampler;
+	WGPUBindGroupLayout bind_group_layout;
+	WGPUShaderModule    shader_module;
+	WGPUPipelineLayout  pipeline_layout;
+	int n_formats;
+	struct gpudl__2d_pipelines formats[GPUDL__2D_MAX_FORMATS];
+
+	// outgrown vertex buffers; passes recorded earlier in the frame may
+	// still use them, so they go after the frame's submits
+	int n_retired, cap_retired;
+	WGPUBuffer* retired;
+};
+
+struct gpudl__streamed_texture {
+	int      state; // protected by stream_mutex
+	int      free_requested;
+	uint64_t seq;
+	gpudl_decode_func decode;
+	void*    userdata;
+
+	// either decoded by decode(), or in a mapped file
+	char*    path;
+	size_t   file_offset;
+	struct gpudl_mapped_file file;
+
+	uint8_t* pixels;
+	int      width;
+	int      height;
+	int      n_mips;
+	int      tail_mip;
+	uint8_t* tail_pixels; // mips [tail_mip;n_mips), one after the other
+
+	WGPUTexture     texture;
+	WGPUTextureView view;
+	int             resident_mip;
+	int             next_row; // base mip upload progress
+};
+
+// cache entries are keyed on descriptors flattened into uint64_t words
+struct gpudl__cache_entry {
+	uint64_t  hash;
+	uint64_t* key;
+	int       key_len;
+	void*     object;
+	uint64_t  last_used_frame;
+	int       next; // next entry in bucket (or free list); -1=none
+};
+
+// hash table with chained buckets; entries live in one array and freed
+// ones are recycled through the free list
+struct gpudl__object_cache {
+	int n_buckets; // power of two
+	int* buckets;
+	int n_entries;
+	int cap_entries;
+	struct gpudl__cache_entry* entries;
+	int free_list; // set up together with the buckets
+	struct gpudl_object_cache_stats stats;
+};
+
+#define GPUDL__MAX_BUNDLES (64)
+
+struct gpudl__bundle {
+	gpudl_record_bundle_func record; // NULL if free
+	void* userdata;
+};
+
+struct gpudl__graph_resource {
+	struct gpudl_graph_texture_desc desc;
+	int imported;
+	WGPUTextureView view; // NULL while a transient texture has no memory
+	int physical;         // index in gpudl__graph.physical, or -1
+	int first_pass, last_pass;
+	int needed;
+};
+
+struct gpudl__graph_access {
+	int resource;
+	int write;
+};
+
+struct gpudl__graph_pass {
+	const char* name;
+	gpudl_graph_pass_func fn;
+	void* userdata;
+	int side_effect;
+	int live;
+	int first_access, n_accesses;
+};
+
+struct gpudl__graph_physical {
+	struct gpudl_graph_texture_desc desc;
+	WGPUTexture     texture;
+	WGPUTextureView view;
+	int             in_use;
+	uint64_t        last_used_frame;
+};
+
+struct gpudl__graph {
+	int building;
+	int width, height;
+	int n_resources, cap_resources;
+	struct gpudl__graph_resource* resources;
+	int n_passes, cap_passes;
+	struct gpudl__graph_pass* passes;
+	int n_accesses, cap_accesses;
+	struct gpudl__graph_access* accesses;
+	// the pool; kept between frames
+	int n_physical, cap_physical;
+	struct gpudl__graph_physical* physical;
+	struct gpudl_graph_stats stats;
+};
+
+// frames of queries and readback buffers in rotation
+#define GPUDL__PROFILER_FRAMES (4)
+#define GPUDL__PROFILER_MAX_DEPTH (32)
+
+enum gpudl__profiler_state {
+	GPUDL__PROFILER_FREE = 0,
+	GPUDL__PROFILER_RECORDING,
+	GPUDL__PROFILER_MAPPING,
+	GPUDL__PROFILER_MAPPED,
+	GPUDL__PROFILER_FAILED,
+};
+
+struct gpudl__profiler_frame {
+	enum gpudl__profiler_state state; // MAPPING->MAPPED/FAILED in the map callback
+	uint64_t frame;
+	int n_scopes;
+	struct gpudl_gpu_scope scopes[GPUDL_GPU_PROFILER_MAX_SCOPES];
+	uint64_t cpu_begin_us[GPUDL_GPU_PROFILER_MAX_SCOPES];
+	// 2 timestamps per scope
+	WGPUQuerySet query_set;
+	WGPUBuffer   resolve_buffer;
+	WGPUBuffer   readback_buffer;
+};
+
+#define GPUDL__MAX_ATLASES (16)
+
+struct gpudl__atlas_entry {
+	int layer;
+	int shelf;
+	int x, y;
+	int width, height;
+};
+
+struct gpudl__atlas_shelf {
+	int      y;
+	int      height;
+	int      x; // where the next image goes
+	uint64_t last_used_frame;
+};
+
+struct gpudl__atlas_layer {
+	WGPUTextureView view;
+	int next_y; // where the next shelf goes
+	int n_shelves, cap_shelves;
+	struct gpudl__atlas_shelf* shelves;
+};
+
+struct gpudl__atlas {
+	int in_use;
+	int size;
+	int n_layers;
+	WGPUTexture     texture;
+	WGPUTextureView array_view;
+	struct gpudl__atlas_layer* layers;
+	// key -> malloc()'d struct gpudl__atlas_entry
+	struct gpudl__object_cache entries;
+	struct gpudl_atlas_stats stats;
+};
+
+#ifdef GPUDL_WAYLAND
+struct gpudl__wl_output {
+	struct wl_output* output;
+	uint32_t name; // registry name, for global_remove
+	uint64_t refresh_interval_us; // of the current mode; 0 if unknown
+};
+#endif
+
 struct gpudl__window {
 	int id;
+	unsigned disabled_events;
 	WGPUSurface         wgpu_surface;
 	WGPUSwapChain       wgpu_swap_chain;
+	#ifdef GPUDL_WAYLAND
+	struct wl_surface*   wl_surface;
+	struct xdg_surface*  xdg_surface;
+	struct xdg_toplevel* xdg_toplevel;
+	struct wl_callback*  wl_frame_callback;
+	struct wl_output*    wl_output; // last output the surface entered
+	// configures are acked by gpudl_render_begin(), so that the ack is
+	// committed together with a frame at the new size
+	uint32_t wl_configure_serial;
+	int      wl_configure_pending;
+	int configured_width;
+	int configured_height;
+	#else
 	Window x11_window;
 	XIC    x11_ic;
+	XID    x11_present_event_id;
+	// _NET_WM_SYNC_REQUEST: the window manager sends a value before a
+	// resize, and waits for us to set the counter to it, which we do
+	// once a frame at the new size has been presented
+	XSyncCounter x11_sync_counter;
+	uint64_t     x11_sync_value;
+	int          x11_sync_state; // 0: none, 1: requested, 2: configured after request
+	#endif
 	int width;
 	int height;
+	int cursor;
+	int swap_chain_stale; // size changed; rebuilt by gpudl_render_begin()
+	// see gpudl_2d_flush()
+	WGPUBuffer r2d_vertex_buffer;
+	size_t     r2d_vertex_buffer_size;
+	size_t     r2d_vertex_buffer_used; // this frame
+	enum gpudl_fullscreen_mode fullscreen;
+	WGPUPresentMode present_mode;
+	// gpudl_window_desc.hidden_until_first_frame (X11): 1 while the window
+	// is mapped but fully transparent, 2 once its first frame is
+	// presented, until the present completes
+	int transparent_until_present;
+
+	uint64_t present_ust;
+	uint64_t present_msc;
+	uint64_t refresh_interval_us;
+
+	int   has_pointer;
+	float pointer_x;
+	float pointer_y;
+
+	int mapped;
+	int fully_obscured;
+	int focused;
+	int redraw_pending;
+
+	int      target_fps;
+	uint64_t frame_deadline_us; // when the next frame is due (with a fps limit)
+	uint64_t frame_begin_us;    // time of last gpudl_render_begin()
+	uint64_t app_frame;         // gpudl__runtime.app_frame of the last present
+	struct gpudl_frame_stats frame_stats;
+	double   frame_interval_m2; // for frame_stats.interval_stddev
+
+	// input latency tracing: input_us is the time of the oldest input
+	// event not yet seen by a frame; it's moved to frame_input_us by
+	// gpudl_render_begin(), and queued by gpudl_render_end() until the
+	// frame is presented. 0 means "no input"
+	uint64_t input_us;
+	uint64_t frame_input_us;
+	uint64_t presents_input_us[GPUDL__MAX_FRAMES_AWAITING_PRESENT];
+	int      presents_head;
+	int      presents_n;
+	struct gpudl_latency_histogram latency_histogram;
 };
 
 struct gpudl__cursor {
 	int in_use;
+	int refcount;
+	char* bitmap; // gpudl_make_bitmap_cursor() source, for sharing
+
+	#ifdef GPUDL_WAYLAND
+	struct wl_buffer* wl_buffer;
+	int width;
+	int height;
+	int hotspot_x;
+	int hotspot_y;
+	#else
 	Cursor cursor;
+	#endif
 };
 
 static struct gpudl__runtime {
@@ -281,12 +1151,123 @@ static struct gpudl__runtime {
 
 	WGPULimits limits;
 
+	struct gpudl_throttle_policy throttle_policy;
+
 	int n_windows;
 	struct gpudl__window windows[GPUDL__MAX_WINDOWS];
 
+	#ifndef GPUDL_WAYLAND
+	int window_pool_size;
+	int window_pool_width;
+	int window_pool_height;
+	int n_pooled_windows;
+	struct gpudl__window pooled_windows[GPUDL__MAX_WINDOWS];
+	#endif
+
 	int rendering_window_id;
 	WGPUTextureView rendering_swap_chain_texture_view;
 
+	// see gpudl_set_frames_in_flight(); each gpudl_render_end() adds a
+	// fence to the slot's count until its submitted-work-done callback.
+	// app_frame counts application frames (see gpudl__app_frame_update())
+	int                   frames_in_flight;
+	enum gpudl_frame_wait frame_wait;
+	int                   frame_slot;
+	int                   frame_fence_pending[GPUDL_MAX_FRAMES_IN_FLIGHT];
+	uint64_t              app_frame;
+
+	uint64_t frame_counter; // gpudl_render_end() calls
+
+	// see gpudl_alloc_uniforms(); uniform_shadow is the CPU copy of the
+	// current slot's buffer
+	size_t     uniform_ring_size;
+	size_t     uniform_capacity;
+	size_t     uniform_align;
+	size_t     uniform_used;
+	int        uniform_uploaded;
+	void*      uniform_shadow;
+	WGPUBuffer uniform_buffers[GPUDL_MAX_FRAMES_IN_FLIGHT];
+
+	// see gpudl_stream_texture()
+	int             stream_worker_running;
+	int             stream_quit;
+	pthread_t       stream_worker;
+	pthread_mutex_t stream_mutex;
+	pthread_cond_t  stream_cond;
+	uint64_t        stream_seq;
+	size_t          stream_upload_budget;
+	uint64_t        stream_pumped_app_frame; // gpudl_render_begin() pumps once per application frame
+	struct gpudl__streamed_texture streamed_textures[GPUDL_MAX_STREAMED_TEXTURES];
+	WGPUBindGroupLayout mip_bind_group_layout;
+	WGPUShaderModule    mip_shader_module;
+	WGPUPipelineLayout  mip_pipeline_layout;
+	WGPUComputePipeline mip_pipeline;
+
+	struct gpudl__2d r2d;
+
+	struct gpudl__atlas atlases[GPUDL__MAX_ATLASES];
+
+	struct gpudl__graph graph;
+
+	int has_timestamp_query;
+	float profiler_ns_per_tick; // 0=1
+	struct gpudl__profiler_frame profiler_frames[GPUDL__PROFILER_FRAMES];
+	struct gpudl__profiler_frame* profiler_current; // being recorded
+	int profiler_stack[GPUDL__PROFILER_MAX_DEPTH]; // scope indices; -1=not recorded
+	int profiler_depth;
+	struct gpudl_gpu_scope profiler_latest[GPUDL_GPU_PROFILER_MAX_SCOPES];
+	int profiler_latest_n;
+	uint64_t profiler_latest_frame;
+	int profiler_latest_valid;
+
+	// scratch space for building cache keys
+	uint64_t* cache_key;
+	int       cache_key_len;
+	int       cache_key_cap;
+
+	struct gpudl__object_cache sampler_cache;
+	struct gpudl__object_cache bind_group_layout_cache;
+	struct gpudl__object_cache bind_group_cache;
+
+	struct gpudl__bundle bundles[GPUDL__MAX_BUNDLES];
+	// bundle handle + variant -> WGPURenderBundle
+	struct gpudl__object_cache bundle_cache;
+
+	#ifdef GPUDL_WAYLAND
+	struct wl_display*      wl_display;
+	struct wl_registry*     wl_registry;
+	struct wl_compositor*   wl_compositor;
+	struct wl_shm*          wl_shm;
+	struct wl_seat*         wl_seat;
+	struct wl_pointer*      wl_pointer;
+	struct wl_keyboard*     wl_keyboard;
+	struct xdg_wm_base*     xdg_wm_base;
+	struct gpudl__wl_output wl_outputs[GPUDL__WL_MAX_OUTPUTS];
+	struct wl_cursor_theme* wl_cursor_theme;
+	struct wl_surface*      wl_cursor_surface;
+	struct xkb_context*     xkb_context;
+	struct xkb_keymap*      xkb_keymap;
+	struct xkb_state*       xkb_state;
+
+	int      wl_pointer_window_id;
+	uint32_t wl_pointer_serial;
+	float    wl_pointer_x;
+	float    wl_pointer_y;
+	int      wl_keyboard_window_id;
+
+	// wayland leaves key repeat to clients
+	int32_t            wl_repeat_rate; // repeats per second; 0=disabled
+	int32_t            wl_repeat_delay; // milliseconds
+	xkb_keycode_t      wl_repeat_keycode; // 0=no key held
+	uint64_t           wl_repeat_next_us;
+	struct gpudl_event wl_repeat_event;
+
+	// wayland delivers events through listener callbacks, so they're
+	// queued here until gpudl_poll_event() picks them up
+	int wl_event_head;
+	int wl_event_tail;
+	struct gpudl_event wl_events[GPUDL__MAX_QUEUED_EVENTS];
+	#else
 	Display* x11_display;
 	int      x11_screen;
 	Window   x11_root_window;
@@ -294,19 +1275,32 @@ static struct gpudl__runtime {
 	int      x11_depth;
 	Colormap x11_colormap;
 	Atom     x11_WM_DELETE_WINDOW;
-	XIM      x11_im;
+	Atom     x11_NET_WM_SYNC_REQUEST;
+	Atom     x11_NET_WM_SYNC_REQUEST_COUNTER;
+	int      x11_sync_available;
+	Atom     x11_NET_WM_STATE;
+	Atom     x11_NET_WM_STATE_FULLSCREEN;
+	Atom     x11_NET_WM_BYPASS_COMPOSITOR;
+	Atom     x11_NET_WM_WINDOW_OPACITY;
+	XIM      x11_im; // opened by the first window that wants one
+	int      x11_present_opcode; // 0 if the Present extension is missing
+	int      x11_detectable_autorepeat;
+	uint8_t  x11_keys_down[32]; // bitset of keycodes, for detecting repeats
 
 	XColor   x11_color_white;
 	XColor   x11_color_black;
+	#endif
 
 	struct gpudl__cursor cursors[GPUDL_MAX_CURSORS];
 } gpudl__runtime;
 
 
+#ifndef GPUDL_WAYLAND
 static int gpudl__x_error_handler(Display* display, XErrorEvent* event) {
         fprintf(stderr, "X11 ERROR?\n");
 	return 0;
 }
+#endif
 
 int gpudl_utf8_decode(const char** c0z, int* n)
 {
@@ -337,324 +1331,3855 @@ int gpudl_utf8_decode(const char** c0z, int* n)
 	return -1;
 }
 
-void gpudl_init()
+// like gpudl__get_window(), but returns NULL instead of aborting when there's
+// no such window (e.g. events arriving for a window that was just closed)
+static struct gpudl__window* gpudl__find_window(int id)
 {
-	if (gpudl__runtime.is_initialized) return;
-
-	{
-		// XXX users should probably have some options in how their
-		// application finds the webgpu-native library?
-		static const char* try_paths[] = {
-			"./libwgpu_native.so", // <- name when doing `cargo build`
-			"./libwgpu.so",        // <- name in releases
-		};
-		void* dh = NULL;
-		for (int i = 0; i < (sizeof(try_paths) / sizeof(try_paths[0])); i++) {
-			dh = dlopen(try_paths[i], RTLD_NOW | RTLD_GLOBAL);
-			if (dh) break;
-		}
-		if (dh == NULL) {
-			fprintf(stderr, "Could not find webgpu-native dynamic library\n");
-			abort();
-		}
-
-		gpudl__runtime.dh = dh;
-		assert(gpudl__runtime.dh != NULL && "could not load ./libwgpu_native.so");
-		#define GPUDL_WGPU_PROC(NAME) \
-			wgpu##NAME = dlsym(dh, "wgpu" #NAME); \
-			if (wgpu##NAME == NULL) fprintf(stderr, "WARNING: symbol wgpu%s not found\n", #NAME);
-		GPUDL_WGPU_PROCS
-		#undef GPUDL_WGPU_PROC
+	const int n_windows = gpudl__runtime.n_windows;
+	for (int i = 0; i < n_windows; i++) {
+		struct gpudl__window* win = &gpudl__runtime.windows[i];
+		if (win->id == id) return win;
 	}
+	return NULL;
+}
 
-	gpudl__runtime.wgpu_instance = wgpuCreateInstance(&(WGPUInstanceDescriptor){});
-	assert(gpudl__runtime.wgpu_instance && "wgpuCreateInstance() failed");
-
-	gpudl__runtime.wgpu_present_mode = WGPUPresentMode_Fifo; // XXX
-
-	gpudl__runtime.limits.maxBindGroups = 4;
-
-	// this inconspicuous boilerplate line seems to have weird and deep
-	// implications for keyboard input:
-	//   without setlocale():   [compose],[a],[e] => "æ", [compose],[a],[a] => "å", [compose],[o],[a] => no KeyPress event at all
-	//   with setlocale():      [compose],[a],[e] => "æ", [compose],[a],[a] => "å", [compose],[o],[a] => "å"
-	setlocale(LC_ALL, "");
+static void gpudl__window_create_swap_chain(struct gpudl__window* win)
+{
+	win->redraw_pending = 1;
+	win->wgpu_swap_chain = wgpuDeviceCreateSwapChain(
+		gpudl__runtime.wgpu_device,
+		win->wgpu_surface,
+		&(WGPUSwapChainDescriptor){
+			.usage = WGPUTextureUsage_RenderAttachment,
+			.format = gpudl__runtime.wgpu_swap_chain_format,
+			.width = win->width,
+			.height = win->height,
+			.presentMode = win->present_mode,
+		}
+	);
+	assert(win->wgpu_swap_chain);
+	assert((win->wgpu_surface == (WGPUSurface)win->wgpu_swap_chain) && "wgpu-native assumption: wgpuDeviceCreateSwapChain() should return the passed surface; otherwise this code must free the previous swap chain?");
+}
 
-	XSetErrorHandler(gpudl__x_error_handler);
-	XInitThreads();
+static void gpudl__window_resize(struct gpudl__window* win, int width, int height)
+{
+	if (win->wgpu_swap_chain && width == win->width && height == win->height) return;
+	win->width = width;
+	win->height = height;
+	gpudl__window_create_swap_chain(win);
+}
 
-	gpudl__runtime.x11_display = XOpenDisplay(NULL);
-	assert(gpudl__runtime.x11_display && "XOpenDisplay() failed");
+static WGPUPresentMode gpudl__get_wgpu_present_mode(enum gpudl_present_mode mode)
+{
+	switch (mode) {
+	case GPUDL_PRESENT_DEFAULT:   return gpudl__runtime.wgpu_present_mode;
+	case GPUDL_PRESENT_FIFO:      return WGPUPresentMode_Fifo;
+	case GPUDL_PRESENT_MAILBOX:   return WGPUPresentMode_Mailbox;
+	case GPUDL_PRESENT_IMMEDIATE: return WGPUPresentMode_Immediate;
+	}
+	assert(!"invalid present mode");
+	return gpudl__runtime.wgpu_present_mode;
+}
 
-	gpudl__runtime.x11_screen = DefaultScreen(gpudl__runtime.x11_display);
-	gpudl__runtime.x11_root_window = XRootWindow(
-		gpudl__runtime.x11_display,
-		gpudl__runtime.x11_screen);
-	gpudl__runtime.x11_visual = DefaultVisual(
-		gpudl__runtime.x11_display,
-		gpudl__runtime.x11_screen);
-	gpudl__runtime.x11_depth = DefaultDepth(
-		gpudl__runtime.x11_display,
-		gpudl__runtime.x11_screen);
-	gpudl__runtime.x11_colormap = XCreateColormap(
-		gpudl__runtime.x11_display,
-		gpudl__runtime.x11_root_window,
-		gpudl__runtime.x11_visual,
-		AllocNone);
-	gpudl__runtime.x11_im = XOpenIM(
-		gpudl__runtime.x11_display,
-		NULL, NULL, NULL);
+uint64_t gpudl_time_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-	for (enum gpudl_system_cursor i = 0; i < GPUDL_CURSOR_END; i++) {
-		unsigned int shape;
-		switch (i) {
-			case GPUDL_CURSOR_DEFAULT: shape = XC_left_ptr; break;
-			case GPUDL_CURSOR_HAND:    shape = XC_hand1; break;
-			case GPUDL_CURSOR_H_ARROW: shape = XC_sb_h_double_arrow; break;
-			case GPUDL_CURSOR_V_ARROW: shape = XC_sb_v_double_arrow; break;
-			case GPUDL_CURSOR_CROSS:   shape = XC_fleur; break;
-			case GPUDL_CURSOR_TEXT:    shape = XC_xterm; break;
-			case GPUDL_CURSOR_END: break;
+static void gpudl__window_presented(struct gpudl__window* win, uint64_t ust, uint64_t msc)
+{
+	#ifndef GPUDL_WAYLAND
+	// (on wayland frame callbacks only come as fast as the application
+	// renders, so the interval comes from the output's mode instead)
+	if (win->present_msc > 0 && msc > win->present_msc && ust > win->present_ust) {
+		const uint64_t interval = (ust - win->present_ust) / (msc - win->present_msc);
+		// individual timestamps jitter a bit, so smooth the estimate
+		win->refresh_interval_us =
+			win->refresh_interval_us == 0
+			? interval
+			: (win->refresh_interval_us*7 + interval) / 8;
+	}
+	#endif
+	win->present_ust = ust;
+	win->present_msc = msc;
+
+	// every completed present corresponds to the oldest queued frame
+	if (win->presents_n > 0) {
+		const uint64_t input_us = win->presents_input_us[win->presents_head];
+		win->presents_head = (win->presents_head + 1) % GPUDL__MAX_FRAMES_AWAITING_PRESENT;
+		win->presents_n--;
+		if (input_us > 0 && ust > input_us) {
+			struct gpudl_latency_histogram* h = &win->latency_histogram;
+			const uint64_t latency = ust - input_us;
+			int bucket = latency / 1000;
+			if (bucket >= GPUDL_LATENCY_HISTOGRAM_BUCKETS) bucket = GPUDL_LATENCY_HISTOGRAM_BUCKETS-1;
+			h->buckets[bucket]++;
+			h->n_samples++;
+			h->sum_us += latency;
+			if (latency > h->max_us) h->max_us = latency;
 		}
-		gpudl__runtime.cursors[i].cursor = XCreateFontCursor(gpudl__runtime.x11_display, shape);
-		gpudl__runtime.cursors[i].in_use = 1;
 	}
+}
 
-	gpudl__runtime.x11_color_white.red = 0xffff;
-	gpudl__runtime.x11_color_white.green = 0xffff;
-	gpudl__runtime.x11_color_white.blue = 0xffff;
-	gpudl__runtime.x11_color_black.red = 0;
-	gpudl__runtime.x11_color_black.green = 0;
-	gpudl__runtime.x11_color_black.blue = 0;
+static void gpudl__window_frame_presenting(struct gpudl__window* win)
+{
+	if (win->presents_n == GPUDL__MAX_FRAMES_AWAITING_PRESENT) {
+		// presents aren't completing (no Present extension, or
+		// completions lost); forget the oldest
+		win->presents_head = (win->presents_head + 1) % GPUDL__MAX_FRAMES_AWAITING_PRESENT;
+		win->presents_n--;
+	}
+	const int i = (win->presents_head + win->presents_n) % GPUDL__MAX_FRAMES_AWAITING_PRESENT;
+	win->presents_input_us[i] = win->frame_input_us;
+	win->presents_n++;
+	win->frame_input_us = 0;
+}
 
-	XAllocColor(gpudl__runtime.x11_display, gpudl__runtime.x11_colormap, &gpudl__runtime.x11_color_white);
-	XAllocColor(gpudl__runtime.x11_display, gpudl__runtime.x11_colormap, &gpudl__runtime.x11_color_black);
+// best guess of when an input event happened, on the gpudl_time_us() clock
+static uint64_t gpudl__event_input_us(const struct gpudl_event* e)
+{
+	if (e->time == 0) return e->receive_us;
+	// X servers and wayland compositors on linux normally use
+	// CLOCK_MONOTONIC for event timestamps, but it isn't guaranteed, so
+	// only trust it if it's plausibly close to the receive time. the
+	// timestamp is 32-bit milliseconds, so compare modulo 2^32
+	const uint32_t age_ms = (uint32_t)(e->receive_us / 1000) - e->time;
+	if (age_ms > 1000 || (uint64_t)age_ms*1000 > e->receive_us) return e->receive_us;
+	return e->receive_us - (uint64_t)age_ms*1000;
 }
 
-void gpudl_set_required_limits(WGPULimits* limits)
+static int gpudl__window_is_visible(struct gpudl__window* win)
 {
-	memcpy(&gpudl__runtime.limits, limits, sizeof *limits);
+	return win->mapped && !win->fully_obscured;
 }
 
-static int gpudl__get_next_serial()
+// returns 1 if this changes whether the window is visible
+static int gpudl__window_update_visibility(struct gpudl__window* win, int mapped, int fully_obscured)
 {
-	return ++gpudl__runtime.serial_counter;
+	const int was_visible = gpudl__window_is_visible(win);
+	win->mapped = mapped;
+	win->fully_obscured = fully_obscured;
+	if (gpudl__window_is_visible(win) == was_visible) return 0;
+	win->frame_deadline_us = 0; // fps limit probably changed
+	if (!was_visible) win->redraw_pending = 1;
+	return 1;
 }
 
-static int gpudl__get_window_index(int id)
+static void gpudl__window_update_focus(struct gpudl__window* win, int focused)
+{
+	if (win->focused == focused) return;
+	win->focused = focused;
+	win->frame_deadline_us = 0;
+}
+
+// frame rate limit according to gpudl_set_target_fps() and the throttle
+// policy; 0 means no limit, and -1 means no frames at all
+static int gpudl__window_get_fps_limit(struct gpudl__window* win)
+{
+	#define MIN_LIMIT(a,b) ((a)==0 ? (b) : (b)==0 ? (a) : (a)<(b) ? (a) : (b))
+	const struct gpudl_throttle_policy* policy = &gpudl__runtime.throttle_policy;
+	int fps = win->target_fps;
+	if (!gpudl__window_is_visible(win) && !win->transparent_until_present) {
+		if (policy->hidden_fps == 0) return -1;
+		fps = MIN_LIMIT(fps, policy->hidden_fps);
+	} else if (!win->focused) {
+		fps = MIN_LIMIT(fps, policy->unfocused_fps);
+	}
+	return fps;
+	#undef MIN_LIMIT
+}
+
+// emits a GPUDL_REDRAW event for the first window with a pending redraw;
+// called when the platform has no other events queued, so that damage from
+// a burst of events turns into a single redraw
+static int gpudl__pop_redraw(struct gpudl_event* e)
 {
 	const int n_windows = gpudl__runtime.n_windows;
 	for (int i = 0; i < n_windows; i++) {
 		struct gpudl__window* win = &gpudl__runtime.windows[i];
-		if (win->id == id) return i;
+		if (!win->redraw_pending || !win->wgpu_swap_chain) continue;
+		win->redraw_pending = 0;
+		memset(e, 0, sizeof *e);
+		e->window_id = win->id;
+		e->type = GPUDL_REDRAW;
+		return 1;
 	}
-	fprintf(stderr, "no window with id %d\n", id);
-	abort();
+	return 0;
 }
 
-static struct gpudl__window* gpudl__get_window(int id)
-{
-	return &gpudl__runtime.windows[gpudl__get_window_index(id)];
-}
+#ifdef GPUDL_WAYLAND
 
+// wayland objects carry the window id (and not a window pointer) as user
+// data, because gpudl_window_close() moves windows around in memory
+#define GPUDL__WL_ID(data) ((int)(intptr_t)(data))
+#define GPUDL__WL_DATA(id) ((void*)(intptr_t)(id))
 
-// lifting some stuff from wgpu.h here...
-#define gpudl__WGPUSType_DeviceExtras  (0x60000001)
-#define gpudl__WGPUSType_AdapterExtras (0x60000002)
-struct gpudl__WGPUAdapterExtras {
-    WGPUChainedStruct chain;
-    WGPUBackendType backend;
-};
+// from linux/input-event-codes.h
+#define GPUDL__BTN_LEFT   (0x110)
+#define GPUDL__BTN_RIGHT  (0x111)
+#define GPUDL__BTN_MIDDLE (0x112)
 
-enum gpudl__WGPUNativeFeature {
-    WGPUNativeFeature_TEXTURE_ADAPTER_SPECIFIC_FORMAT_FEATURES = 0x10000000
-};
+static unsigned gpudl__event_class(enum gpudl_event_type type)
+{
+	switch (type) {
+	case GPUDL_MOTION:
+	case GPUDL_BUTTON:
+	case GPUDL_ENTER:
+	case GPUDL_LEAVE:
+		return GPUDL_EVENTS_POINTER;
+	case GPUDL_KEY:
+	case GPUDL_FOCUS:
+	case GPUDL_UNFOCUS:
+		return GPUDL_EVENTS_KEYBOARD;
+	default:
+		return 0;
+	}
+}
 
-struct gpudl__WGPUDeviceExtras {
-    WGPUChainedStruct chain;
-    enum gpudl__WGPUNativeFeature nativeFeatures;
-    const char* label;
+static struct gpudl_event* gpudl__wl_push_event(int window_id, enum gpudl_event_type type)
+{
+	if (window_id == 0) return NULL;
+	struct gpudl__window* win = gpudl__find_window(window_id);
+	if (win && (win->disabled_events & gpudl__event_class(type))) return NULL;
+	const int next = (gpudl__runtime.wl_event_tail + 1) % GPUDL__MAX_QUEUED_EVENTS;
+	if (next == gpudl__runtime.wl_event_head) {
+		fprintf(stderr, "WARNING: event queue full; dropping event\n");
+		return NULL;
+	}
+	struct gpudl_event* e = &gpudl__runtime.wl_events[gpudl__runtime.wl_event_tail];
+	gpudl__runtime.wl_event_tail = next;
+	memset(e, 0, sizeof *e);
+	e->window_id = window_id;
+	e->type = type;
+	e->receive_us = gpudl_time_us();
+	return e;
+}
+
+// reads and dispatches wayland events, waiting at most timeout_ms for them
+// to arrive (0=don't wait, -1=wait forever)
+static void gpudl__wl_dispatch(int timeout_ms)
+{
+	struct wl_display* dpy = gpudl__runtime.wl_display;
+	while (wl_display_prepare_read(dpy) != 0) wl_display_dispatch_pending(dpy);
+	wl_display_flush(dpy);
+	struct pollfd pfd = {
+		.fd = wl_display_get_fd(dpy),
+		.events = POLLIN,
+	};
+	if (poll(&pfd, 1, timeout_ms) > 0) {
+		wl_display_read_events(dpy);
+	} else {
+		wl_display_cancel_read(dpy);
+	}
+	wl_display_dispatch_pending(dpy);
+}
+
+static struct wl_buffer* gpudl__wl_create_argb_buffer(int width, int height, const uint32_t* pixels)
+{
+	const int stride = width * 4;
+	const int size = stride * height;
+
+	static int counter;
+	char name[64];
+	snprintf(name, sizeof name, "/gpudl-%d-%d", getpid(), ++counter);
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		fprintf(stderr, "shm_open() failed\n");
+		abort();
+	}
+	shm_unlink(name);
+	if (ftruncate(fd, size) != 0) {
+		fprintf(stderr, "ftruncate() failed\n");
+		abort();
+	}
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	assert((data != MAP_FAILED) && "mmap() failed");
+	memcpy(data, pixels, size);
+	munmap(data, size);
+
+	struct wl_shm_pool* pool = wl_shm_create_pool(gpudl__runtime.wl_shm, fd, size);
+	struct wl_buffer* buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride, WL_SHM_FORMAT_ARGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	assert(buffer);
+	return buffer;
+}
+
+static void gpudl__wl_update_cursor(void)
+{
+	struct gpudl__window* win = gpudl__find_window(gpudl__runtime.wl_pointer_window_id);
+	if (win == NULL || gpudl__runtime.wl_pointer == NULL) return;
+	struct gpudl__cursor* cc = &gpudl__runtime.cursors[win->cursor];
+	if (cc->wl_buffer == NULL) return; // no cursor theme?
+	struct wl_surface* s = gpudl__runtime.wl_cursor_surface;
+	wl_surface_attach(s, cc->wl_buffer, 0, 0);
+	wl_surface_damage(s, 0, 0, cc->width, cc->height);
+	wl_surface_commit(s);
+	wl_pointer_set_cursor(gpudl__runtime.wl_pointer, gpudl__runtime.wl_pointer_serial, s, cc->hotspot_x, cc->hotspot_y);
+}
+
+static int gpudl__wl_surface_window_id(struct wl_surface* surface)
+{
+	return surface ? GPUDL__WL_ID(wl_surface_get_user_data(surface)) : 0;
+}
+
+static void gpudl__wl_pointer_enter(void* data, struct wl_pointer* pointer, uint32_t serial, struct wl_surface* surface, wl_fixed_t sx, wl_fixed_t sy)
+{
+	const int window_id = gpudl__wl_surface_window_id(surface);
+	gpudl__runtime.wl_pointer_window_id = window_id;
+	gpudl__runtime.wl_pointer_serial = serial;
+	gpudl__runtime.wl_pointer_x = wl_fixed_to_double(sx);
+	gpudl__runtime.wl_pointer_y = wl_fixed_to_double(sy);
+	gpudl__wl_push_event(window_id, GPUDL_ENTER);
+	struct gpudl_event* e = gpudl__wl_push_event(window_id, GPUDL_MOTION);
+	if (e) {
+		e->motion.x = gpudl__runtime.wl_pointer_x;
+		e->motion.y = gpudl__runtime.wl_pointer_y;
+	}
+	gpudl__wl_update_cursor();
+}
+
+static void gpudl__wl_pointer_leave(void* data, struct wl_pointer* pointer, uint32_t serial, struct wl_surface* surface)
+{
+	gpudl__wl_push_event(gpudl__runtime.wl_pointer_window_id, GPUDL_LEAVE);
+	gpudl__runtime.wl_pointer_window_id = 0;
+}
+
+static void gpudl__wl_pointer_motion(void* data, struct wl_pointer* pointer, uint32_t time, wl_fixed_t sx, wl_fixed_t sy)
+{
+	gpudl__runtime.wl_pointer_x = wl_fixed_to_double(sx);
+	gpudl__runtime.wl_pointer_y = wl_fixed_to_double(sy);
+	struct gpudl_event* e = gpudl__wl_push_event(gpudl__runtime.wl_pointer_window_id, GPUDL_MOTION);
+	if (e == NULL) return;
+	e->time = time;
+	e->motion.x = gpudl__runtime.wl_pointer_x;
+	e->motion.y = gpudl__runtime.wl_pointer_y;
+}
+
+static void gpudl__wl_pointer_button(void* data, struct wl_pointer* pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state)
+{
+	enum gpudl_button which;
+	switch (button) {
+	case GPUDL__BTN_LEFT:   which = GPUDL_BUTTON_LEFT;   break;
+	case GPUDL__BTN_MIDDLE: which = GPUDL_BUTTON_MIDDLE; break;
+	case GPUDL__BTN_RIGHT:  which = GPUDL_BUTTON_RIGHT;  break;
+	default: return;
+	}
+	struct gpudl_event* e = gpudl__wl_push_event(gpudl__runtime.wl_pointer_window_id, GPUDL_BUTTON);
+	if (e == NULL) return;
+	e->time = time;
+	e->button.which = which;
+	e->button.pressed = (state == WL_POINTER_BUTTON_STATE_PRESSED);
+	e->button.x = gpudl__runtime.wl_pointer_x;
+	e->button.y = gpudl__runtime.wl_pointer_y;
+}
+
+static void gpudl__wl_pointer_axis(void* data, struct wl_pointer* pointer, uint32_t time, uint32_t axis, wl_fixed_t value)
+{
+}
+
+static const struct wl_pointer_listener gpudl__wl_pointer_listener = {
+	.enter  = gpudl__wl_pointer_enter,
+	.leave  = gpudl__wl_pointer_leave,
+	.motion = gpudl__wl_pointer_motion,
+	.button = gpudl__wl_pointer_button,
+	.axis   = gpudl__wl_pointer_axis,
+};
+
+static int gpudl__xkb_translate_keysym(xkb_keysym_t sym)
+{
+	switch (sym) {
+	case XKB_KEY_Escape:    return '\033';
+	case XKB_KEY_Tab:       return '\t';
+	case XKB_KEY_BackSpace: return '\b';
+	case XKB_KEY_Return:    return '\r';
+
+	case XKB_KEY_Insert:    return GK_INSERT;
+	case XKB_KEY_Delete:    return GK_DELETE;
+	case XKB_KEY_Home:      return GK_HOME;
+	case XKB_KEY_End:       return GK_END;
+	case XKB_KEY_Left:      return GK_LEFT;
+	case XKB_KEY_Up:        return GK_UP;
+	case XKB_KEY_Right:     return GK_RIGHT;
+	case XKB_KEY_Down:      return GK_DOWN;
+	case XKB_KEY_Page_Up:   return GK_PGUP;
+	case XKB_KEY_Page_Down: return GK_PGDN;
+	case XKB_KEY_Print:     return GK_PRINT;
+
+	case XKB_KEY_F1:        return GK_F1;
+	case XKB_KEY_F2:        return GK_F2;
+	case XKB_KEY_F3:        return GK_F3;
+	case XKB_KEY_F4:        return GK_F4;
+	case XKB_KEY_F5:        return GK_F5;
+	case XKB_KEY_F6:        return GK_F6;
+	case XKB_KEY_F7:        return GK_F7;
+	case XKB_KEY_F8:        return GK_F8;
+	case XKB_KEY_F9:        return GK_F9;
+	case XKB_KEY_F10:       return GK_F10;
+	case XKB_KEY_F11:       return GK_F11;
+	case XKB_KEY_F12:       return GK_F12;
+
+	case XKB_KEY_Shift_L:   return GK_LSHIFT;
+	case XKB_KEY_Shift_R:   return GK_RSHIFT;
+	case XKB_KEY_Control_L: return GK_LCTRL;
+	case XKB_KEY_Control_R: return GK_RCTRL;
+	case XKB_KEY_Alt_L:     return GK_LALT;
+	case XKB_KEY_Alt_R:     return GK_RALT;
+	case XKB_KEY_Super_L:   return GK_LSUPER;
+	case XKB_KEY_Super_R:   return GK_RSUPER;
+	}
+	// xkbcommon knows the keysym/unicode relation, so no
+	// keysymdef_converter.py table is needed here
+	const uint32_t codepoint = xkb_keysym_to_utf32(sym);
+	return codepoint > 0 ? (int)codepoint : GK_UNKNOWN;
+}
+
+static void gpudl__wl_keyboard_keymap(void* data, struct wl_keyboard* keyboard, uint32_t format, int32_t fd, uint32_t size)
+{
+	if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1) {
+		close(fd);
+		return;
+	}
+	char* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return;
+	struct xkb_keymap* keymap = xkb_keymap_new_from_string(gpudl__runtime.xkb_context, map, XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	munmap(map, size);
+	if (keymap == NULL) {
+		fprintf(stderr, "WARNING: xkb_keymap_new_from_string() failed\n");
+		return;
+	}
+	if (gpudl__runtime.xkb_state) xkb_state_unref(gpudl__runtime.xkb_state);
+	if (gpudl__runtime.xkb_keymap) xkb_keymap_unref(gpudl__runtime.xkb_keymap);
+	gpudl__runtime.xkb_keymap = keymap;
+	gpudl__runtime.xkb_state = xkb_state_new(keymap);
+}
+
+static void gpudl__wl_keyboard_enter(void* data, struct wl_keyboard* keyboard, uint32_t serial, struct wl_surface* surface, struct wl_array* keys)
+{
+	gpudl__runtime.wl_keyboard_window_id = gpudl__wl_surface_window_id(surface);
+	struct gpudl__window* win = gpudl__find_window(gpudl__runtime.wl_keyboard_window_id);
+	if (win) gpudl__window_update_focus(win, 1);
+	gpudl__wl_push_event(gpudl__runtime.wl_keyboard_window_id, GPUDL_FOCUS);
+}
+
+static void gpudl__wl_keyboard_leave(void* data, struct wl_keyboard* keyboard, uint32_t serial, struct wl_surface* surface)
+{
+	struct gpudl__window* win = gpudl__find_window(gpudl__runtime.wl_keyboard_window_id);
+	if (win) gpudl__window_update_focus(win, 0);
+	gpudl__wl_push_event(gpudl__runtime.wl_keyboard_window_id, GPUDL_UNFOCUS);
+	gpudl__runtime.wl_keyboard_window_id = 0;
+	gpudl__runtime.wl_repeat_keycode = 0;
+}
+
+static void gpudl__wl_keyboard_key(void* data, struct wl_keyboard* keyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
+{
+	struct xkb_state* xs = gpudl__runtime.xkb_state;
+	if (xs == NULL) return;
+	struct gpudl_event* e = gpudl__wl_push_event(gpudl__runtime.wl_keyboard_window_id, GPUDL_KEY);
+	if (e == NULL) return;
+	e->time = time;
+	struct gpudl_event_key* ke = &e->key;
+
+	ke->pressed = (state == WL_KEYBOARD_KEY_STATE_PRESSED);
+
+	// evdev scancode => xkb keycode
+	const xkb_keycode_t keycode = key + 8;
+
+	// keysym from the first shift level, i.e. ignoring modifiers (like
+	// XLookupKeysym(...,0) does in the X11 backend)
+	const xkb_keysym_t* syms = NULL;
+	const int n_syms = xkb_keymap_key_get_syms_by_level(
+		gpudl__runtime.xkb_keymap,
+		keycode,
+		xkb_state_key_get_layout(xs, keycode),
+		0,
+		&syms);
+	ke->keysym = n_syms > 0 ? gpudl__xkb_translate_keysym(syms[0]) : GK_UNKNOWN;
+
+	if (!ke->pressed && keycode == gpudl__runtime.wl_repeat_keycode) {
+		gpudl__runtime.wl_repeat_keycode = 0;
+	}
+
+	if (ke->pressed) {
+		const int codepoint = xkb_state_key_get_utf32(xs, keycode);
+		if (codepoint > 0) {
+			// see the X11 backend for the reasoning behind this
+			#ifdef GPUDL_I_HAVE_A_SUFFICIENTLY_LONG_BEARD
+			ke->codepoint = codepoint;
+			#else
+			ke->codepoint =
+				((0 <= codepoint && codepoint < ' ') || codepoint == 0x7f)
+				? (int)xkb_state_key_get_one_sym(xs, keycode)
+				: codepoint;
+			#endif
+		}
+		if (gpudl__runtime.wl_repeat_rate > 0 && xkb_keymap_key_repeats(gpudl__runtime.xkb_keymap, keycode)) {
+			gpudl__runtime.wl_repeat_keycode = keycode;
+			gpudl__runtime.wl_repeat_next_us = gpudl_time_us() + (uint64_t)gpudl__runtime.wl_repeat_delay * 1000;
+			memcpy(&gpudl__runtime.wl_repeat_event, e, sizeof *e);
+			gpudl__runtime.wl_repeat_event.time = 0;
+			gpudl__runtime.wl_repeat_event.key.repeat = 1;
+		}
+	}
+}
+
+static void gpudl__wl_keyboard_modifiers(void* data, struct wl_keyboard* keyboard, uint32_t serial, uint32_t mods_depressed, uint32_t mods_latched, uint32_t mods_locked, uint32_t group)
+{
+	if (gpudl__runtime.xkb_state == NULL) return;
+	xkb_state_update_mask(gpudl__runtime.xkb_state, mods_depressed, mods_latched, mods_locked, 0, 0, group);
+}
+
+static void gpudl__wl_keyboard_repeat_info(void* data, struct wl_keyboard* keyboard, int32_t rate, int32_t delay)
+{
+	gpudl__runtime.wl_repeat_rate = rate;
+	gpudl__runtime.wl_repeat_delay = delay;
+	if (rate <= 0) gpudl__runtime.wl_repeat_keycode = 0;
+}
+
+static const struct wl_keyboard_listener gpudl__wl_keyboard_listener = {
+	.keymap      = gpudl__wl_keyboard_keymap,
+	.enter       = gpudl__wl_keyboard_enter,
+	.leave       = gpudl__wl_keyboard_leave,
+	.key         = gpudl__wl_keyboard_key,
+	.modifiers   = gpudl__wl_keyboard_modifiers,
+	.repeat_info = gpudl__wl_keyboard_repeat_info,
+};
+
+// wl_pointer.release/wl_keyboard.release are seat version 3+; older
+// seats only have the client-side destroy
+static void gpudl__wl_pointer_release(struct wl_pointer* pointer)
+{
+	if (wl_pointer_get_version(pointer) >= WL_POINTER_RELEASE_SINCE_VERSION) {
+		wl_pointer_release(pointer);
+	} else {
+		wl_pointer_destroy(pointer);
+	}
+}
+
+static void gpudl__wl_keyboard_release(struct wl_keyboard* keyboard)
+{
+	if (wl_keyboard_get_version(keyboard) >= WL_KEYBOARD_RELEASE_SINCE_VERSION) {
+		wl_keyboard_release(keyboard);
+	} else {
+		wl_keyboard_destroy(keyboard);
+	}
+}
+
+static void gpudl__wl_seat_capabilities(void* data, struct wl_seat* seat, uint32_t caps)
+{
+	const int has_pointer = (caps & WL_SEAT_CAPABILITY_POINTER) != 0;
+	if (has_pointer && gpudl__runtime.wl_pointer == NULL) {
+		gpudl__runtime.wl_pointer = wl_seat_get_pointer(seat);
+		wl_pointer_add_listener(gpudl__runtime.wl_pointer, &gpudl__wl_pointer_listener, NULL);
+	} else if (!has_pointer && gpudl__runtime.wl_pointer != NULL) {
+		gpudl__wl_pointer_release(gpudl__runtime.wl_pointer);
+		gpudl__runtime.wl_pointer = NULL;
+	}
+
+	const int has_keyboard = (caps & WL_SEAT_CAPABILITY_KEYBOARD) != 0;
+	if (has_keyboard && gpudl__runtime.wl_keyboard == NULL) {
+		gpudl__runtime.wl_keyboard = wl_seat_get_keyboard(seat);
+		wl_keyboard_add_listener(gpudl__runtime.wl_keyboard, &gpudl__wl_keyboard_listener, NULL);
+	} else if (!has_keyboard && gpudl__runtime.wl_keyboard != NULL) {
+		gpudl__wl_keyboard_release(gpudl__runtime.wl_keyboard);
+		gpudl__runtime.wl_keyboard = NULL;
+	}
+}
+
+static void gpudl__wl_seat_name(void* data, struct wl_seat* seat, const char* name)
+{
+}
+
+static const struct wl_seat_listener gpudl__wl_seat_listener = {
+	.capabilities = gpudl__wl_seat_capabilities,
+	.name         = gpudl__wl_seat_name,
+};
+
+static void gpudl__xdg_wm_base_ping(void* data, struct xdg_wm_base* xdg_wm_base, uint32_t serial)
+{
+	xdg_wm_base_pong(xdg_wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener gpudl__xdg_wm_base_listener = {
+	.ping = gpudl__xdg_wm_base_ping,
+};
+
+static void gpudl__wl_window_ack_configure(struct gpudl__window* win)
+{
+	xdg_surface_ack_configure(win->xdg_surface, win->wl_configure_serial);
+	win->wl_configure_pending = 0;
+	// a zero configured size means that we decide
+	const int width  = win->configured_width  > 0 ? win->configured_width  : win->width  > 0 ? win->width  : 256;
+	const int height = win->configured_height > 0 ? win->configured_height : win->height > 0 ? win->height : 256;
+	gpudl__window_resize(win, width, height);
+}
+
+static void gpudl__xdg_surface_configure(void* data, struct xdg_surface* xdg_surface, uint32_t serial)
+{
+	struct gpudl__window* win = gpudl__find_window(GPUDL__WL_ID(data));
+	if (win == NULL) {
+		xdg_surface_ack_configure(xdg_surface, serial);
+		return;
+	}
+	win->wl_configure_serial = serial;
+	win->wl_configure_pending = 1;
+	win->redraw_pending = 1;
+	// the initial configure has to be acked before anything can be
+	// rendered; later ones wait for gpudl_render_begin()
+	if (!win->wgpu_swap_chain) gpudl__wl_window_ack_configure(win);
+	// xdg-shell doesn't tell whether we're minimized or covered (but
+	// then the compositor stops sending frame callbacks, which stops
+	// rendering just as well)
+	if (gpudl__window_update_visibility(win, 1, 0)) {
+		struct gpudl_event* e = gpudl__wl_push_event(win->id, GPUDL_VISIBILITY);
+		if (e) e->visibility.visible = 1;
+	}
+}
+
+static const struct xdg_surface_listener gpudl__xdg_surface_listener = {
+	.configure = gpudl__xdg_surface_configure,
+};
+
+static void gpudl__xdg_toplevel_configure(void* data, struct xdg_toplevel* xdg_toplevel, int32_t width, int32_t height, struct wl_array* states)
+{
+	// only takes effect in the xdg_surface.configure that follows
+	struct gpudl__window* win = gpudl__find_window(GPUDL__WL_ID(data));
+	if (win == NULL) return;
+	win->configured_width = width;
+	win->configured_height = height;
+}
+
+static void gpudl__xdg_toplevel_close(void* data, struct xdg_toplevel* xdg_toplevel)
+{
+	gpudl__wl_push_event(GPUDL__WL_ID(data), GPUDL_CLOSE);
+}
+
+static const struct xdg_toplevel_listener gpudl__xdg_toplevel_listener = {
+	.configure = gpudl__xdg_toplevel_configure,
+	.close     = gpudl__xdg_toplevel_close,
+};
+
+static void gpudl__wl_frame_done(void* data, struct wl_callback* callback, uint32_t time)
+{
+	wl_callback_destroy(callback);
+	struct gpudl__window* win = gpudl__find_window(GPUDL__WL_ID(data));
+	if (win == NULL) return;
+	win->wl_frame_callback = NULL;
+	// `time` has an undefined base, so it can't be compared with
+	// gpudl_time_us(). the callback is sent when the compositor starts a
+	// repaint, which is close enough to vblank to be useful for pacing.
+	// MSC is faked; it only counts our own frames
+	gpudl__window_presented(win, gpudl_time_us(), win->present_msc + 1);
+	win->refresh_interval_us = 0;
+	for (int i = 0; i < GPUDL__WL_MAX_OUTPUTS; i++) {
+		const struct gpudl__wl_output* o = &gpudl__runtime.wl_outputs[i];
+		if (o->output != NULL && o->output == win->wl_output) win->refresh_interval_us = o->refresh_interval_us;
+	}
+}
+
+static const struct wl_callback_listener gpudl__wl_frame_listener = {
+	.done = gpudl__wl_frame_done,
+};
+
+static void gpudl__wl_output_geometry(void* data, struct wl_output* output, int32_t x, int32_t y, int32_t physical_width, int32_t physical_height, int32_t subpixel, const char* make, const char* model, int32_t transform)
+{
+}
+
+static void gpudl__wl_output_mode(void* data, struct wl_output* output, uint32_t flags, int32_t width, int32_t height, int32_t refresh)
+{
+	if (!(flags & WL_OUTPUT_MODE_CURRENT)) return;
+	struct gpudl__wl_output* o = data;
+	// refresh is in mHz
+	o->refresh_interval_us = refresh > 0 ? 1000000000ull / refresh : 0;
+}
+
+static const struct wl_output_listener gpudl__wl_output_listener = {
+	.geometry = gpudl__wl_output_geometry,
+	.mode     = gpudl__wl_output_mode,
+};
+
+static void gpudl__wl_surface_enter(void* data, struct wl_surface* surface, struct wl_output* output)
+{
+	struct gpudl__window* win = gpudl__find_window(GPUDL__WL_ID(data));
+	if (win) win->wl_output = output;
+}
+
+static void gpudl__wl_surface_leave(void* data, struct wl_surface* surface, struct wl_output* output)
+{
+	struct gpudl__window* win = gpudl__find_window(GPUDL__WL_ID(data));
+	if (win && win->wl_output == output) win->wl_output = NULL;
+}
+
+static const struct wl_surface_listener gpudl__wl_surface_listener = {
+	.enter = gpudl__wl_surface_enter,
+	.leave = gpudl__wl_surface_leave,
+};
+
+static void gpudl__wl_registry_global(void* data, struct wl_registry* registry, uint32_t name, const char* interface, uint32_t version)
+{
+	#define MIN(a,b) ((a)<(b)?(a):(b))
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		gpudl__runtime.wl_compositor = wl_registry_bind(registry, name, &wl_compositor_interface, MIN(version, 4));
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		gpudl__runtime.wl_shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, wl_seat_interface.name) == 0 && gpudl__runtime.wl_seat == NULL) {
+		// NOTE version 5+ adds wl_pointer.frame and friends, which
+		// gpudl__wl_pointer_listener doesn't handle
+		gpudl__runtime.wl_seat = wl_registry_bind(registry, name, &wl_seat_interface, MIN(version, 4));
+		wl_seat_add_listener(gpudl__runtime.wl_seat, &gpudl__wl_seat_listener, NULL);
+	} else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+		gpudl__runtime.xdg_wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(gpudl__runtime.xdg_wm_base, &gpudl__xdg_wm_base_listener, NULL);
+	} else if (strcmp(interface, wl_output_interface.name) == 0) {
+		// NOTE version 1 has everything needed for the refresh rate,
+		// and wl_output.release (version 3) isn't needed with it
+		for (int i = 0; i < GPUDL__WL_MAX_OUTPUTS; i++) {
+			struct gpudl__wl_output* o = &gpudl__runtime.wl_outputs[i];
+			if (o->output != NULL) continue;
+			o->output = wl_registry_bind(registry, name, &wl_output_interface, 1);
+			o->name = name;
+			o->refresh_interval_us = 0;
+			wl_output_add_listener(o->output, &gpudl__wl_output_listener, o);
+			break;
+		}
+	}
+	#undef MIN
+}
+
+static void gpudl__wl_registry_global_remove(void* data, struct wl_registry* registry, uint32_t name)
+{
+	for (int i = 0; i < GPUDL__WL_MAX_OUTPUTS; i++) {
+		struct gpudl__wl_output* o = &gpudl__runtime.wl_outputs[i];
+		if (o->output == NULL || o->name != name) continue;
+		for (int j = 0; j < GPUDL__MAX_WINDOWS; j++) {
+			struct gpudl__window* win = &gpudl__runtime.windows[j];
+			if (win->wl_output == o->output) win->wl_output = NULL;
+		}
+		wl_output_destroy(o->output);
+		memset(o, 0, sizeof *o);
+	}
+}
+
+static const struct wl_registry_listener gpudl__wl_registry_listener = {
+	.global        = gpudl__wl_registry_global,
+	.global_remove = gpudl__wl_registry_global_remove,
+};
+
+#endif // GPUDL_WAYLAND
+
+void gpudl_init()
+{
+	if (gpudl__runtime.is_initialized) return;
+
+	{
+		// XXX users should probably have some options in how their
+		// application finds the webgpu-native library?
+		static const char* try_paths[] = {
+			"./libwgpu_native.so", // <- name when doing `cargo build`
+			"./libwgpu.so",        // <- name in releases
+		};
+		void* dh = NULL;
+		for (int i = 0; i < (sizeof(try_paths) / sizeof(try_paths[0])); i++) {
+			dh = dlopen(try_paths[i], RTLD_NOW | RTLD_GLOBAL);
+			if (dh) break;
+		}
+		if (dh == NULL) {
+			fprintf(stderr, "Could not find webgpu-native dynamic library\n");
+			abort();
+		}
+
+		gpudl__runtime.dh = dh;
+		assert(gpudl__runtime.dh != NULL && "could not load ./libwgpu_native.so");
+		#define GPUDL_WGPU_PROC(NAME) \
+			wgpu##NAME = dlsym(dh, "wgpu" #NAME); \
+			if (wgpu##NAME == NULL) fprintf(stderr, "WARNING: symbol wgpu%s not found\n", #NAME);
+		GPUDL_WGPU_PROCS
+		#undef GPUDL_WGPU_PROC
+		#define GPUDL_WGPU_PROC(NAME) wgpu##NAME = dlsym(dh, "wgpu" #NAME);
+		GPUDL_WGPU_OPTIONAL_PROCS
+		#undef GPUDL_WGPU_PROC
+	}
+
+	gpudl__runtime.wgpu_instance = wgpuCreateInstance(&(WGPUInstanceDescriptor){});
+	assert(gpudl__runtime.wgpu_instance && "wgpuCreateInstance() failed");
+
+	gpudl__runtime.wgpu_present_mode = WGPUPresentMode_Fifo; // XXX
+
+	gpudl__runtime.limits.maxBindGroups = 4;
+
+	// this inconspicuous boilerplate line seems to have weird and deep
+	// implications for keyboard input:
+	//   without setlocale():   [compose],[a],[e] => "æ", [compose],[a],[a] => "å", [compose],[o],[a] => no KeyPress event at all
+	//   with setlocale():      [compose],[a],[e] => "æ", [compose],[a],[a] => "å", [compose],[o],[a] => "å"
+	setlocale(LC_ALL, "");
+
+	#ifdef GPUDL_WAYLAND
+	gpudl__runtime.wl_display = wl_display_connect(NULL);
+	assert(gpudl__runtime.wl_display && "wl_display_connect() failed");
+
+	gpudl__runtime.xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	assert(gpudl__runtime.xkb_context && "xkb_context_new() failed");
+
+	gpudl__runtime.wl_registry = wl_display_get_registry(gpudl__runtime.wl_display);
+	wl_registry_add_listener(gpudl__runtime.wl_registry, &gpudl__wl_registry_listener, NULL);
+	wl_display_roundtrip(gpudl__runtime.wl_display); // binds globals
+	assert(gpudl__runtime.wl_compositor && "compositor has no wl_compositor");
+	assert(gpudl__runtime.wl_shm && "compositor has no wl_shm");
+	assert(gpudl__runtime.xdg_wm_base && "compositor has no xdg_wm_base (xdg-shell)");
+	wl_display_roundtrip(gpudl__runtime.wl_display); // seat capabilities, keymap
+
+	gpudl__runtime.wl_cursor_surface = wl_compositor_create_surface(gpudl__runtime.wl_compositor);
+	gpudl__runtime.wl_cursor_theme = wl_cursor_theme_load(NULL, 24, gpudl__runtime.wl_shm);
+	for (enum gpudl_system_cursor i = 0; i < GPUDL_CURSOR_END; i++) {
+		const char* name = NULL;
+		switch (i) {
+			case GPUDL_CURSOR_DEFAULT: name = "left_ptr"; break;
+			case GPUDL_CURSOR_HAND:    name = "hand1"; break;
+			case GPUDL_CURSOR_H_ARROW: name = "sb_h_double_arrow"; break;
+			case GPUDL_CURSOR_V_ARROW: name = "sb_v_double_arrow"; break;
+			case GPUDL_CURSOR_CROSS:   name = "fleur"; break;
+			case GPUDL_CURSOR_TEXT:    name = "xterm"; break;
+			case GPUDL_CURSOR_END: break;
+		}
+		struct gpudl__cursor* cc = &gpudl__runtime.cursors[i];
+		cc->in_use = 1;
+		struct wl_cursor* wc = gpudl__runtime.wl_cursor_theme ? wl_cursor_theme_get_cursor(gpudl__runtime.wl_cursor_theme, name) : NULL;
+		if (wc == NULL || wc->image_count == 0) {
+			fprintf(stderr, "WARNING: no '%s' cursor in cursor theme\n", name);
+			continue;
+		}
+		struct wl_cursor_image* img = wc->images[0];
+		cc->wl_buffer = wl_cursor_image_get_buffer(img);
+		cc->width = img->width;
+		cc->height = img->height;
+		cc->hotspot_x = img->hotspot_x;
+		cc->hotspot_y = img->hotspot_y;
+	}
+	#else
+	XSetErrorHandler(gpudl__x_error_handler);
+	XInitThreads();
+
+	gpudl__runtime.x11_display = XOpenDisplay(NULL);
+	assert(gpudl__runtime.x11_display && "XOpenDisplay() failed");
+
+	gpudl__runtime.x11_screen = DefaultScreen(gpudl__runtime.x11_display);
+	gpudl__runtime.x11_root_window = XRootWindow(
+		gpudl__runtime.x11_display,
+		gpudl__runtime.x11_screen);
+	gpudl__runtime.x11_visual = DefaultVisual(
+		gpudl__runtime.x11_display,
+		gpudl__runtime.x11_screen);
+	gpudl__runtime.x11_depth = DefaultDepth(
+		gpudl__runtime.x11_display,
+		gpudl__runtime.x11_screen);
+	gpudl__runtime.x11_colormap = XCreateColormap(
+		gpudl__runtime.x11_display,
+		gpudl__runtime.x11_root_window,
+		gpudl__runtime.x11_visual,
+		AllocNone);
+
+	{
+		// with detectable auto-repeat, held keys generate KeyPress
+		// events only, instead of KeyRelease+KeyPress pairs
+		Bool supported = False;
+		XkbSetDetectableAutoRepeat(gpudl__runtime.x11_display, True, &supported);
+		gpudl__runtime.x11_detectable_autorepeat = supported;
+	}
+
+	for (enum gpudl_system_cursor i = 0; i < GPUDL_CURSOR_END; i++) {
+		unsigned int shape;
+		switch (i) {
+			case GPUDL_CURSOR_DEFAULT: shape = XC_left_ptr; break;
+			case GPUDL_CURSOR_HAND:    shape = XC_hand1; break;
+			case GPUDL_CURSOR_H_ARROW: shape = XC_sb_h_double_arrow; break;
+			case GPUDL_CURSOR_V_ARROW: shape = XC_sb_v_double_arrow; break;
+			case GPUDL_CURSOR_CROSS:   shape = XC_fleur; break;
+			case GPUDL_CURSOR_TEXT:    shape = XC_xterm; break;
+			case GPUDL_CURSOR_END: break;
+		}
+		gpudl__runtime.cursors[i].cursor = XCreateFontCursor(gpudl__runtime.x11_display, shape);
+		gpudl__runtime.cursors[i].in_use = 1;
+	}
+
+	gpudl__runtime.x11_color_white.red = 0xffff;
+	gpudl__runtime.x11_color_white.green = 0xffff;
+	gpudl__runtime.x11_color_white.blue = 0xffff;
+	gpudl__runtime.x11_color_black.red = 0;
+	gpudl__runtime.x11_color_black.green = 0;
+	gpudl__runtime.x11_color_black.blue = 0;
+
+	XAllocColor(gpudl__runtime.x11_display, gpudl__runtime.x11_colormap, &gpudl__runtime.x11_color_white);
+	XAllocColor(gpudl__runtime.x11_display, gpudl__runtime.x11_colormap, &gpudl__runtime.x11_color_black);
+
+	{
+		int opcode, event_base, error_base;
+		if (XPresentQueryExtension(gpudl__runtime.x11_display, &opcode, &event_base, &error_base)) {
+			gpudl__runtime.x11_present_opcode = opcode;
+		} else {
+			fprintf(stderr, "WARNING: X server has no Present extension; no presentation timing available\n");
+		}
+	}
+
+	{
+		int event_base, error_base, major, minor;
+		gpudl__runtime.x11_sync_available =
+			XSyncQueryExtension(gpudl__runtime.x11_display, &event_base, &error_base)
+			&& XSyncInitialize(gpudl__runtime.x11_display, &major, &minor);
+	}
+	#endif
+
+	gpudl__runtime.is_initialized = 1;
+}
+
+void gpudl_set_required_limits(WGPULimits* limits)
+{
+	memcpy(&gpudl__runtime.limits, limits, sizeof *limits);
+}
+
+static int gpudl__get_next_serial()
+{
+	return ++gpudl__runtime.serial_counter;
+}
+
+static int gpudl__get_window_index(int id)
+{
+	const int n_windows = gpudl__runtime.n_windows;
+	for (int i = 0; i < n_windows; i++) {
+		struct gpudl__window* win = &gpudl__runtime.windows[i];
+		if (win->id == id) return i;
+	}
+	fprintf(stderr, "no window with id %d\n", id);
+	abort();
+}
+
+static struct gpudl__window* gpudl__get_window(int id)
+{
+	struct gpudl__window* win = gpudl__find_window(id);
+	if (win == NULL) {
+		fprintf(stderr, "no window with id %d\n", id);
+		abort();
+	}
+	return win;
+}
+
+
+// lifting some stuff from wgpu.h here...
+#define gpudl__WGPUSType_DeviceExtras  (0x60000001)
+#define gpudl__WGPUSType_AdapterExtras (0x60000002)
+struct gpudl__WGPUAdapterExtras {
+    WGPUChainedStruct chain;
+    WGPUBackendType backend;
+};
+
+enum gpudl__WGPUNativeFeature {
+    WGPUNativeFeature_TEXTURE_ADAPTER_SPECIFIC_FORMAT_FEATURES = 0x10000000
+};
+
+struct gpudl__WGPUDeviceExtras {
+    WGPUChainedStruct chain;
+    enum gpudl__WGPUNativeFeature nativeFeatures;
+    const char* label;
     const char* tracePath;
 };
 
 
-static void gpudl__request_adapter_callback(WGPURequestAdapterStatus status, WGPUAdapter received, const char *message, void *userdata) {
-	*(WGPUAdapter *)userdata = received;
+static void gpudl__request_adapter_callback(WGPURequestAdapterStatus status, WGPUAdapter received, const char *message, void *userdata) {
+	*(WGPUAdapter *)userdata = received;
+}
+
+static void gpudl__request_device_callback(WGPURequestDeviceStatus status, WGPUDevice received, const char *message, void *userdata) {
+	*(WGPUDevice *)userdata = received;
+}
+
+static void gpudl__wgpu_error_callback(WGPUErrorType type, char const* message, void* userdata)
+{
+	const char* ts = NULL;
+	switch (type) {
+	case WGPUErrorType_NoError: ts = "(noerror)"; break;
+	case WGPUErrorType_Validation: ts = "(validation)"; break;
+	case WGPUErrorType_OutOfMemory: ts = "(outofmemory)"; break;
+	case WGPUErrorType_Unknown: ts = "(unknown)"; break;
+	case WGPUErrorType_DeviceLost: ts = "(devicelost)"; break;
+	default: ts = "(unhandled)"; break;
+	}
+	assert(ts);
+	fprintf(stderr, "WGPU UNCAPTURED ERROR %s: %s\n", ts, message);
+}
+
+static void gpudl__wgpu_post_init(struct gpudl__window* win)
+{
+	if (gpudl__runtime.wgpu_adapter) return;
+
+	wgpuInstanceRequestAdapter(
+		gpudl__runtime.wgpu_instance,
+		&(WGPURequestAdapterOptions){
+			.compatibleSurface = win->wgpu_surface,
+			.nextInChain = (const WGPUChainedStruct*) &(struct gpudl__WGPUAdapterExtras) {
+				.chain = (WGPUChainedStruct) {
+					.next = NULL,
+					.sType = gpudl__WGPUSType_AdapterExtras,
+				},
+				.backend = WGPUBackendType_Vulkan,
+				//.backend = WGPUBackendType_OpenGL, // XXX not supported
+				//.backend = WGPUBackendType_OpenGLES, // XXX not supported
+			},
+		},
+		gpudl__request_adapter_callback,
+		&gpudl__runtime.wgpu_adapter);
+	assert((gpudl__runtime.wgpu_adapter != NULL) && "got no adapter; expected wgpuInstanceRequestAdapter() to not actually be async");
+
+	WGPURequiredLimits* required_limits = &(WGPURequiredLimits){
+		.nextInChain = NULL,
+	};
+	memcpy(&required_limits->limits, &gpudl__runtime.limits, sizeof required_limits->limits);
+
+	// optional features; only timestamp queries (for the GPU profiler) so far
+	const WGPUFeatureName timestamp_query = WGPUFeatureName_TimestampQuery;
+	gpudl__runtime.has_timestamp_query = wgpuAdapterHasFeature != NULL && wgpuAdapterHasFeature(gpudl__runtime.wgpu_adapter, timestamp_query);
+
+	wgpuAdapterRequestDevice(
+		gpudl__runtime.wgpu_adapter,
+		&(WGPUDeviceDescriptor){
+			// XXX isn't this useless?
+			.nextInChain = (const WGPUChainedStruct *)&(struct gpudl__WGPUDeviceExtras){
+				.chain = (WGPUChainedStruct){
+					.next = NULL,
+					.sType = gpudl__WGPUSType_DeviceExtras,
+				},
+				.label = "Device",
+				.tracePath = NULL,
+			},
+			.requiredFeaturesCount = gpudl__runtime.has_timestamp_query ? 1 : 0,
+			.requiredFeatures = &timestamp_query,
+			.requiredLimits = required_limits,
+		},
+		gpudl__request_device_callback,
+		&gpudl__runtime.wgpu_device);
+	assert((gpudl__runtime.wgpu_device != NULL) && "got no device; expected wgpuAdapterRequestDevice() to not actually be async");
+
+
+	gpudl__runtime.wgpu_queue = wgpuDeviceGetQueue(gpudl__runtime.wgpu_device);
+	assert(gpudl__runtime.wgpu_queue);
+
+	gpudl__runtime.wgpu_swap_chain_format = wgpuSurfaceGetPreferredFormat(win->wgpu_surface, gpudl__runtime.wgpu_adapter);
+
+	wgpuDeviceSetUncapturedErrorCallback(gpudl__runtime.wgpu_device, gpudl__wgpu_error_callback, NULL);
+}
+
+static void gpudl__window_release_wgpu(struct gpudl__window* win)
+{
+	if (gpudl__runtime.rendering_window_id == win->id && win->id != 0) {
+		// closed between gpudl_render_begin()/end()
+		wgpuTextureViewDrop(gpudl__runtime.rendering_swap_chain_texture_view);
+		gpudl__runtime.rendering_swap_chain_texture_view = NULL;
+		gpudl__runtime.rendering_window_id = 0;
+	}
+	// NOTE the swap chain is the surface in wgpu-native (see
+	// gpudl__window_create_swap_chain()), so this frees both
+	if (win->wgpu_surface && wgpuSurfaceDrop) wgpuSurfaceDrop(win->wgpu_surface);
+	win->wgpu_surface = NULL;
+	win->wgpu_swap_chain = NULL;
+}
+
+#ifndef GPUDL_WAYLAND
+// creates an unmapped window with everything that doesn't depend on how it's
+// shown, i.e. what pooled windows have ready. win->disabled_events and
+// win->present_mode must be set
+static void gpudl__x11_window_create(struct gpudl__window* win, int x, int y, int width, int height, int no_input_method)
+{
+	// NOTE FocusChangeMask is selected regardless of disabled_events
+	// because win->focused drives the unfocused fps cap; GPUDL_FOCUS and
+	// GPUDL_UNFOCUS are dropped in gpudl__poll_event() instead
+	long event_mask = StructureNotifyMask | PropertyChangeMask | FocusChangeMask;
+	if (!(win->disabled_events & GPUDL_EVENTS_POINTER)) {
+		event_mask |= EnterWindowMask | LeaveWindowMask | ButtonPressMask | ButtonReleaseMask | PointerMotionMask;
+	}
+	if (!(win->disabled_events & GPUDL_EVENTS_KEYBOARD)) {
+		event_mask |= KeyPressMask | KeyReleaseMask;
+	}
+	if (!(win->disabled_events & GPUDL_EVENTS_WINDOW)) {
+		event_mask |= ExposureMask | VisibilityChangeMask;
+	}
+
+	win->x11_window = XCreateWindow(
+		gpudl__runtime.x11_display,
+		gpudl__runtime.x11_root_window,
+		x, y,
+		width, height,
+		0, // border width
+		gpudl__runtime.x11_depth,
+		InputOutput,
+		gpudl__runtime.x11_visual,
+		CWBorderPixel | CWColormap | CWEventMask,
+		&(XSetWindowAttributes) {
+			.background_pixmap = None,
+			.colormap = gpudl__runtime.x11_colormap,
+			.border_pixel = 0,
+			.event_mask = event_mask,
+		}
+	);
+	assert(win->x11_window && "XCreateWindow() failed");
+
+	if (!no_input_method && !(win->disabled_events & GPUDL_EVENTS_KEYBOARD)) {
+		if (gpudl__runtime.x11_im == NULL) {
+			gpudl__runtime.x11_im = XOpenIM(
+				gpudl__runtime.x11_display,
+				NULL, NULL, NULL);
+		}
+		if (gpudl__runtime.x11_im != NULL) {
+			win->x11_ic = XCreateIC(
+				gpudl__runtime.x11_im,
+				XNInputStyle,      XIMPreeditNothing | XIMStatusNothing,
+				XNClientWindow,    win->x11_window,
+				XNFocusWindow,     win->x11_window,
+				NULL);
+			assert(win->x11_ic != NULL);
+		}
+	}
+
+	// windows otherwise inherit the root window cursor; defining it
+	// explicitly keeps win->cursor truthful
+	XDefineCursor(gpudl__runtime.x11_display, win->x11_window, gpudl__runtime.cursors[GPUDL_CURSOR_DEFAULT].cursor);
+
+	if (gpudl__runtime.x11_WM_DELETE_WINDOW == None) {
+		gpudl__runtime.x11_WM_DELETE_WINDOW = XInternAtom(gpudl__runtime.x11_display, "WM_DELETE_WINDOW", False);
+		gpudl__runtime.x11_NET_WM_SYNC_REQUEST = XInternAtom(gpudl__runtime.x11_display, "_NET_WM_SYNC_REQUEST", False);
+		gpudl__runtime.x11_NET_WM_SYNC_REQUEST_COUNTER = XInternAtom(gpudl__runtime.x11_display, "_NET_WM_SYNC_REQUEST_COUNTER", False);
+	}
+	{
+		Atom protocols[2];
+		int n_protocols = 0;
+		protocols[n_protocols++] = gpudl__runtime.x11_WM_DELETE_WINDOW;
+		if (gpudl__runtime.x11_sync_available) {
+			XSyncValue zero;
+			XSyncIntToValue(&zero, 0);
+			win->x11_sync_counter = XSyncCreateCounter(gpudl__runtime.x11_display, zero);
+			XChangeProperty(gpudl__runtime.x11_display, win->x11_window, gpudl__runtime.x11_NET_WM_SYNC_REQUEST_COUNTER, XA_CARDINAL, 32, PropModeReplace, (unsigned char*)&win->x11_sync_counter, 1);
+			protocols[n_protocols++] = gpudl__runtime.x11_NET_WM_SYNC_REQUEST;
+		}
+		XSetWMProtocols(gpudl__runtime.x11_display, win->x11_window, protocols, n_protocols);
+	}
+
+	if (gpudl__runtime.x11_present_opcode) {
+		// presents are done by wgpu/the vulkan driver, but
+		// CompleteNotify events are sent to every client that asks
+		win->x11_present_event_id = XPresentSelectInput(gpudl__runtime.x11_display, win->x11_window, PresentCompleteNotifyMask);
+	}
+
+	win->wgpu_surface = wgpuInstanceCreateSurface(
+		gpudl__runtime.wgpu_instance,
+		&(WGPUSurfaceDescriptor){
+			.label = NULL,
+			.nextInChain = (const WGPUChainedStruct *)&(WGPUSurfaceDescriptorFromXlibWindow){
+				.chain = (WGPUChainedStruct){
+					.next = NULL,
+					.sType = WGPUSType_SurfaceDescriptorFromXlibWindow,
+				},
+				.display = gpudl__runtime.x11_display,
+				.window = win->x11_window,
+			},
+		}
+	);
+	assert(win->wgpu_surface);
+
+	gpudl__wgpu_post_init(win);
+
+	// no need to wait for ConfigureNotify; if the window manager picks
+	// another size, the swap chain is rebuilt then
+	gpudl__window_resize(win, width, height);
+}
+
+static void gpudl__x11_window_destroy(struct gpudl__window* win)
+{
+	Display* dpy = gpudl__runtime.x11_display;
+	gpudl__window_release_wgpu(win);
+	if (win->x11_ic) XDestroyIC(win->x11_ic);
+	if (win->x11_present_event_id) XPresentFreeInput(dpy, win->x11_window, win->x11_present_event_id);
+	if (win->x11_sync_counter) XSyncDestroyCounter(dpy, win->x11_sync_counter);
+	XDestroyWindow(dpy, win->x11_window);
+}
+
+// ends transparent_until_present (see gpudl_window_open_ex())
+static void gpudl__x11_window_make_opaque(struct gpudl__window* win)
+{
+	XDeleteProperty(gpudl__runtime.x11_display, win->x11_window, gpudl__runtime.x11_NET_WM_WINDOW_OPACITY);
+	XFlush(gpudl__runtime.x11_display);
+	win->transparent_until_present = 0;
+}
+
+// pooled windows are reused as-is, so only windows that look like fresh
+// default ones may go back to the pool
+static int gpudl__x11_window_is_poolable(struct gpudl__window* win)
+{
+	// (a fullscreen window keeps _NET_WM_STATE_FULLSCREEN and
+	// _NET_WM_BYPASS_COMPOSITOR on the X window, which pooling would
+	// pass on to the next gpudl_window_open())
+	return win->disabled_events == 0
+		&& win->fullscreen == GPUDL_WINDOWED
+		&& (win->x11_ic != NULL || gpudl__runtime.x11_im == NULL);
+}
+
+static int gpudl__x11_fill_window_pool(int max_new)
+{
+	int n_new = 0;
+	while (n_new < max_new && gpudl__runtime.n_pooled_windows < gpudl__runtime.window_pool_size) {
+		struct gpudl__window* win = &gpudl__runtime.pooled_windows[gpudl__runtime.n_pooled_windows++];
+		memset(win, 0, sizeof *win);
+		win->present_mode = gpudl__runtime.wgpu_present_mode;
+		gpudl__x11_window_create(win, 0, 0, gpudl__runtime.window_pool_width, gpudl__runtime.window_pool_height, 0);
+		n_new++;
+	}
+	return n_new;
+}
+#endif
+
+int gpudl_window_open(const char* title)
+{
+	return gpudl_window_open_ex(&(struct gpudl_window_desc) {
+		.title = title,
+	});
+}
+
+int gpudl_window_open_ex(const struct gpudl_window_desc* desc)
+{
+	assert((gpudl__runtime.n_windows < GPUDL__MAX_WINDOWS) && "too many windowz!");
+	struct gpudl__window* win = &gpudl__runtime.windows[gpudl__runtime.n_windows++];
+	memset(win, 0, sizeof *win);
+
+	win->id = gpudl__get_next_serial();
+	win->disabled_events = desc->disabled_events;
+	win->present_mode = gpudl__get_wgpu_present_mode(desc->present_mode);
+	const char* title = desc->title ? desc->title : "";
+	const int width = desc->width > 0 ? desc->width : 256;
+	const int height = desc->height > 0 ? desc->height : 256;
+
+	#ifdef GPUDL_WAYLAND
+	win->wl_surface = wl_compositor_create_surface(gpudl__runtime.wl_compositor);
+	assert(win->wl_surface && "wl_compositor_create_surface() failed");
+	wl_surface_add_listener(win->wl_surface, &gpudl__wl_surface_listener, GPUDL__WL_DATA(win->id));
+
+	win->xdg_surface = xdg_wm_base_get_xdg_surface(gpudl__runtime.xdg_wm_base, win->wl_surface);
+	assert(win->xdg_surface && "xdg_wm_base_get_xdg_surface() failed");
+	xdg_surface_add_listener(win->xdg_surface, &gpudl__xdg_surface_listener, GPUDL__WL_DATA(win->id));
+
+	win->xdg_toplevel = xdg_surface_get_toplevel(win->xdg_surface);
+	assert(win->xdg_toplevel && "xdg_surface_get_toplevel() failed");
+	xdg_toplevel_add_listener(win->xdg_toplevel, &gpudl__xdg_toplevel_listener, GPUDL__WL_DATA(win->id));
+	xdg_toplevel_set_title(win->xdg_toplevel, title);
+
+	if (win->disabled_events & GPUDL_EVENTS_POINTER) {
+		// empty input region; pointer events go to whatever is below
+		struct wl_region* region = wl_compositor_create_region(gpudl__runtime.wl_compositor);
+		wl_surface_set_input_region(win->wl_surface, region);
+		wl_region_destroy(region);
+	}
+
+	win->wgpu_surface = wgpuInstanceCreateSurface(
+		gpudl__runtime.wgpu_instance,
+		&(WGPUSurfaceDescriptor){
+			.label = NULL,
+			.nextInChain = (const WGPUChainedStruct *)&(WGPUSurfaceDescriptorFromWaylandSurface){
+				.chain = (WGPUChainedStruct){
+					.next = NULL,
+					.sType = WGPUSType_SurfaceDescriptorFromWaylandSurface,
+				},
+				.display = gpudl__runtime.wl_display,
+				.surface = win->wl_surface,
+			},
+		}
+	);
+	assert(win->wgpu_surface);
+
+	gpudl__wgpu_post_init(win);
+
+	// committing without a buffer makes the compositor send the initial
+	// configure, which in turn creates the swap chain (at our preferred
+	// size if the compositor leaves it up to us). the surface is mapped
+	// by the first present, so there's never a blank window
+	win->width = width;
+	win->height = height;
+	wl_surface_commit(win->wl_surface);
+	wl_display_roundtrip(gpudl__runtime.wl_display);
+	#else
+	if (gpudl__runtime.n_pooled_windows > 0 && desc->disabled_events == 0 && !desc->no_input_method) {
+		const int id = win->id;
+		memcpy(win, &gpudl__runtime.pooled_windows[--gpudl__runtime.n_pooled_windows], sizeof *win);
+		win->id = id;
+		if (width != win->width || height != win->height) {
+			XResizeWindow(gpudl__runtime.x11_display, win->x11_window, width, height);
+			gpudl__window_resize(win, width, height);
+		}
+		if (desc->position_set) {
+			XMoveWindow(gpudl__runtime.x11_display, win->x11_window, desc->x, desc->y);
+		}
+		const WGPUPresentMode present_mode = gpudl__get_wgpu_present_mode(desc->present_mode);
+		if (present_mode != win->present_mode) {
+			win->present_mode = present_mode;
+			gpudl__window_create_swap_chain(win);
+		}
+	} else {
+		gpudl__x11_window_create(win, desc->x, desc->y, width, height, desc->no_input_method);
+	}
+
+	XStoreName(gpudl__runtime.x11_display, win->x11_window, title);
+
+	{
+		// window managers generally ignore XCreateWindow()
+		// geometry unless it's marked as user-specified
+		XSizeHints hints = {0};
+		hints.flags = USSize;
+		hints.width = width;
+		hints.height = height;
+		if (desc->position_set) {
+			hints.flags |= USPosition;
+			hints.x = desc->x;
+			hints.y = desc->y;
+		}
+		XSetWMNormalHints(gpudl__runtime.x11_display, win->x11_window, &hints);
+	}
+
+	if (desc->hidden_until_first_frame) {
+		// presenting to an unmapped window goes nowhere, so the window
+		// is mapped right away, but made fully transparent (by the
+		// compositor, if any) until its first frame is on screen.
+		// gpudl_render_begin() waits for the MapNotify
+		if (gpudl__runtime.x11_NET_WM_WINDOW_OPACITY == None) {
+			gpudl__runtime.x11_NET_WM_WINDOW_OPACITY = XInternAtom(gpudl__runtime.x11_display, "_NET_WM_WINDOW_OPACITY", False);
+		}
+		const long opacity = 0;
+		XChangeProperty(gpudl__runtime.x11_display, win->x11_window, gpudl__runtime.x11_NET_WM_WINDOW_OPACITY, XA_CARDINAL, 32, PropModeReplace, (unsigned char*)&opacity, 1);
+		win->transparent_until_present = 1;
+	}
+	XMapWindow(gpudl__runtime.x11_display, win->x11_window);
+	#endif
+
+	return win->id;
+}
+
+WGPUSurface gpudl_window_get_surface(int window_id)
+{
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	return win->wgpu_surface;
+}
+
+void gpudl_window_set_present_mode(int window_id, enum gpudl_present_mode mode)
+{
+	assert((gpudl__runtime.rendering_window_id != window_id) && "can't change present mode while rendering the window");
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	const WGPUPresentMode present_mode = gpudl__get_wgpu_present_mode(mode);
+	if (present_mode == win->present_mode) return;
+	win->present_mode = present_mode;
+	if (win->wgpu_swap_chain) gpudl__window_create_swap_chain(win);
+}
+
+void gpudl_window_get_size(int window_id, int* width, int* height)
+{
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	if (width)  *width  = win->width;
+	if (height) *height = win->height;
+}
+
+static void gpudl__2d_retire_buffer(WGPUBuffer buffer);
+
+void gpudl_window_close(int window_id)
+{
+	int index = gpudl__get_window_index(window_id);
+	struct gpudl__window* win = &gpudl__runtime.windows[index];
+	if (win->r2d_vertex_buffer) gpudl__2d_retire_buffer(win->r2d_vertex_buffer);
+	#ifdef GPUDL_WAYLAND
+	if (gpudl__runtime.wl_pointer_window_id == window_id) gpudl__runtime.wl_pointer_window_id = 0;
+	if (gpudl__runtime.wl_keyboard_window_id == window_id) gpudl__runtime.wl_keyboard_window_id = 0;
+	if (win->wl_frame_callback) wl_callback_destroy(win->wl_frame_callback);
+	gpudl__window_release_wgpu(win);
+	xdg_toplevel_destroy(win->xdg_toplevel);
+	xdg_surface_destroy(win->xdg_surface);
+	wl_surface_destroy(win->wl_surface);
+	#else
+	if (gpudl__runtime.n_pooled_windows < gpudl__runtime.window_pool_size && gpudl__x11_window_is_poolable(win)) {
+		if (gpudl__runtime.rendering_window_id == window_id) {
+			wgpuTextureViewDrop(gpudl__runtime.rendering_swap_chain_texture_view);
+			gpudl__runtime.rendering_swap_chain_texture_view = NULL;
+			gpudl__runtime.rendering_window_id = 0;
+		}
+		// ICCCM 4.1.4: a toplevel that is to be reused must be
+		// withdrawn, not just unmapped, or the window manager may keep
+		// its frame, taskbar entry and state
+		XWithdrawWindow(gpudl__runtime.x11_display, win->x11_window, gpudl__runtime.x11_screen);
+		if (win->transparent_until_present) gpudl__x11_window_make_opaque(win);
+		if (win->x11_ic) XUnsetICFocus(win->x11_ic);
+		struct gpudl__window* pw = &gpudl__runtime.pooled_windows[gpudl__runtime.n_pooled_windows++];
+		memset(pw, 0, sizeof *pw);
+		pw->x11_window           = win->x11_window;
+		pw->x11_ic               = win->x11_ic;
+		pw->x11_present_event_id = win->x11_present_event_id;
+		pw->x11_sync_counter     = win->x11_sync_counter;
+		pw->wgpu_surface         = win->wgpu_surface;
+		pw->wgpu_swap_chain      = win->wgpu_swap_chain;
+		pw->width                = win->width;
+		pw->height               = win->height;
+		pw->cursor               = win->cursor;
+		pw->present_mode         = win->present_mode;
+	} else {
+		gpudl__x11_window_destroy(win);
+		// (closing isn't latency critical, unlike opening)
+		gpudl__x11_fill_window_pool(1);
+	}
+	#endif
+	int n_move = (gpudl__runtime.n_windows - index) - 1;
+	if (n_move > 0) {
+		memmove(
+			&gpudl__runtime.windows[index],
+			&gpudl__runtime.windows[index+1],
+			n_move * sizeof(gpudl__runtime.windows[0])
+		);
+	}
+	gpudl__runtime.n_windows--;
+}
+
+void gpudl_set_window_pool(int n, int width, int height)
+{
+	#ifndef GPUDL_WAYLAND
+	// (on wayland an xdg_toplevel can't be hidden and shown again
+	// without the client attaching buffers, which wgpu does, so there's
+	// nothing to pool)
+	assert(0 <= n && n <= GPUDL__MAX_WINDOWS);
+	gpudl__runtime.window_pool_size = n;
+	gpudl__runtime.window_pool_width = width > 0 ? width : 256;
+	gpudl__runtime.window_pool_height = height > 0 ? height : 256;
+	while (gpudl__runtime.n_pooled_windows > n) {
+		gpudl__x11_window_destroy(&gpudl__runtime.pooled_windows[--gpudl__runtime.n_pooled_windows]);
+	}
+	gpudl__x11_fill_window_pool(n);
+	#endif
+}
+
+void gpudl_refill_window_pool(void)
+{
+	#ifndef GPUDL_WAYLAND
+	gpudl__x11_fill_window_pool(gpudl__runtime.window_pool_size);
+	#endif
+}
+
+static uint64_t gpudl__hash_words(const uint64_t* words, int n)
+{
+	uint64_t h = 0xcbf29ce484222325;
+	for (int i = 0; i < n; i++) {
+		h = (h ^ words[i]) * 0x9e3779b97f4a7c15;
+		h ^= h >> 29;
+	}
+	return h;
+}
+
+static void gpudl__cache_key_reset(void)
+{
+	gpudl__runtime.cache_key_len = 0;
+}
+
+static void gpudl__cache_key_push(uint64_t word)
+{
+	if (gpudl__runtime.cache_key_len == gpudl__runtime.cache_key_cap) {
+		gpudl__runtime.cache_key_cap = gpudl__runtime.cache_key_cap > 0 ? gpudl__runtime.cache_key_cap * 2 : 64;
+		gpudl__runtime.cache_key = realloc(gpudl__runtime.cache_key, gpudl__runtime.cache_key_cap * sizeof gpudl__runtime.cache_key[0]);
+		assert(gpudl__runtime.cache_key != NULL);
+	}
+	gpudl__runtime.cache_key[gpudl__runtime.cache_key_len++] = word;
+}
+
+static void gpudl__cache_key_push_ptr(const void* ptr)
+{
+	gpudl__cache_key_push((uint64_t)(uintptr_t)ptr);
+}
+
+static void gpudl__cache_key_push_float(float f)
+{
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof bits);
+	gpudl__cache_key_push(bits);
+}
+
+static void gpudl__object_cache_rehash(struct gpudl__object_cache* cache, int n_buckets)
+{
+	free(cache->buckets);
+	cache->n_buckets = n_buckets;
+	cache->buckets = malloc(n_buckets * sizeof cache->buckets[0]);
+	assert(cache->buckets != NULL);
+	for (int i = 0; i < n_buckets; i++) cache->buckets[i] = -1;
+	for (int i = 0; i < cache->n_entries; i++) {
+		struct gpudl__cache_entry* e = &cache->entries[i];
+		if (e->key == NULL) continue; // on free list
+		const int b = e->hash & (n_buckets-1);
+		e->next = cache->buckets[b];
+		cache->buckets[b] = i;
+	}
+}
+
+// looks up the key built with gpudl__cache_key_push*(); returns NULL on a
+// miss
+static struct gpudl__cache_entry* gpudl__object_cache_find(struct gpudl__object_cache* cache)
+{
+	const uint64_t* key = gpudl__runtime.cache_key;
+	const int key_len = gpudl__runtime.cache_key_len;
+	const uint64_t hash = gpudl__hash_words(key, key_len);
+
+	if (cache->n_buckets == 0) {
+		cache->free_list = -1;
+		gpudl__object_cache_rehash(cache, 64);
+	}
+
+	for (int i = cache->buckets[hash & (cache->n_buckets-1)]; i >= 0; i = cache->entries[i].next) {
+		struct gpudl__cache_entry* e = &cache->entries[i];
+		if (e->hash != hash || e->key_len != key_len) continue;
+		if (memcmp(e->key, key, key_len * sizeof key[0]) != 0) continue;
+		e->last_used_frame = gpudl__runtime.frame_counter;
+		cache->stats.n_hits++;
+		return e;
+	}
+	return NULL;
+}
+
+// like gpudl__object_cache_find(), but on a miss an entry is added with a
+// NULL object, which the caller must fill in
+static struct gpudl__cache_entry* gpudl__object_cache_get(struct gpudl__object_cache* cache)
+{
+	struct gpudl__cache_entry* found = gpudl__object_cache_find(cache);
+	if (found != NULL) return found;
+
+	const uint64_t* key = gpudl__runtime.cache_key;
+	const int key_len = gpudl__runtime.cache_key_len;
+	const uint64_t hash = gpudl__hash_words(key, key_len);
+
+	cache->stats.n_misses++;
+	cache->stats.n_entries++;
+	if (cache->stats.n_entries > cache->n_buckets) {
+		gpudl__object_cache_rehash(cache, cache->n_buckets * 2);
+	}
+
+	int index;
+	if (cache->free_list >= 0) {
+		index = cache->free_list;
+		cache->free_list = cache->entries[index].next;
+	} else {
+		if (cache->n_entries == cache->cap_entries) {
+			cache->cap_entries = cache->cap_entries > 0 ? cache->cap_entries * 2 : 64;
+			cache->entries = realloc(cache->entries, cache->cap_entries * sizeof cache->entries[0]);
+			assert(cache->entries != NULL);
+		}
+		index = cache->n_entries++;
+	}
+
+	struct gpudl__cache_entry* e = &cache->entries[index];
+	memset(e, 0, sizeof *e);
+	e->hash = hash;
+	e->key_len = key_len;
+	e->key = malloc(key_len * sizeof key[0]);
+	assert(e->key != NULL);
+	memcpy(e->key, key, key_len * sizeof key[0]);
+	e->last_used_frame = gpudl__runtime.frame_counter;
+	const int b = hash & (cache->n_buckets-1);
+	e->next = cache->buckets[b];
+	cache->buckets[b] = index;
+	return e;
+}
+
+// drops and removes entries for which pred() returns true
+static void gpudl__object_cache_remove_if(struct gpudl__object_cache* cache, int(*pred)(struct gpudl__cache_entry*, const void*), const void* ctx, void(*drop)(void*))
+{
+	for (int b = 0; b < cache->n_buckets; b++) {
+		int* link = &cache->buckets[b];
+		while (*link >= 0) {
+			const int index = *link;
+			struct gpudl__cache_entry* e = &cache->entries[index];
+			if (!pred(e, ctx)) {
+				link = &e->next;
+				continue;
+			}
+			*link = e->next;
+			if (drop && e->object) drop(e->object);
+			free(e->key);
+			e->key = NULL;
+			e->object = NULL;
+			e->next = cache->free_list;
+			cache->free_list = index;
+			cache->stats.n_entries--;
+			cache->stats.n_evictions++;
+		}
+	}
+}
+
+static void gpudl__object_cache_clear(struct gpudl__object_cache* cache, void(*drop)(void*))
+{
+	for (int i = 0; i < cache->n_entries; i++) {
+		struct gpudl__cache_entry* e = &cache->entries[i];
+		if (e->key == NULL) continue;
+		if (drop && e->object) drop(e->object);
+		free(e->key);
+	}
+	free(cache->entries);
+	free(cache->buckets);
+	memset(cache, 0, sizeof *cache);
+}
+
+static void gpudl__forget_bundles_using(const void* resource);
+
+static void gpudl__drop_bind_group(void* object)
+{
+	gpudl__forget_bundles_using(object);
+	wgpuBindGroupDrop(object);
+}
+
+static void gpudl__drop_bind_group_layout(void* object)
+{
+	if (wgpuBindGroupLayoutDrop) wgpuBindGroupLayoutDrop(object);
+}
+
+static void gpudl__drop_sampler(void* object)
+{
+	if (wgpuSamplerDrop) wgpuSamplerDrop(object);
+}
+
+static int gpudl__bind_group_is_stale(struct gpudl__cache_entry* e, const void* ctx)
+{
+	return (gpudl__runtime.frame_counter - e->last_used_frame) > GPUDL_BIND_GROUP_CACHE_MAX_AGE;
+}
+
+static void gpudl__evict_bind_groups(void)
+{
+	gpudl__object_cache_remove_if(&gpudl__runtime.bind_group_cache, gpudl__bind_group_is_stale, NULL, gpudl__drop_bind_group);
+}
+
+// bind group keys: layout, entryCount, then per entry:
+#define GPUDL__BIND_GROUP_KEY_ENTRY_WORDS (6) // binding, buffer, offset, size, sampler, textureView
+
+static int gpudl__bind_group_uses(struct gpudl__cache_entry* e, const void* resource)
+{
+	const uint64_t r = (uint64_t)(uintptr_t)resource;
+	const int n = e->key[1];
+	for (int i = 0; i < n; i++) {
+		const uint64_t* w = &e->key[2 + i*GPUDL__BIND_GROUP_KEY_ENTRY_WORDS];
+		if (w[1] == r || w[4] == r || w[5] == r) return 1;
+	}
+	return 0;
+}
+
+WGPUSampler gpudl_get_sampler(const WGPUSamplerDescriptor* desc)
+{
+	assert((desc->nextInChain == NULL) && "chained sampler descriptors are not cacheable");
+	gpudl__cache_key_reset();
+	gpudl__cache_key_push(desc->addressModeU);
+	gpudl__cache_key_push(desc->addressModeV);
+	gpudl__cache_key_push(desc->addressModeW);
+	gpudl__cache_key_push(desc->magFilter);
+	gpudl__cache_key_push(desc->minFilter);
+	gpudl__cache_key_push(desc->mipmapFilter);
+	gpudl__cache_key_push_float(desc->lodMinClamp);
+	gpudl__cache_key_push_float(desc->lodMaxClamp);
+	gpudl__cache_key_push(desc->compare);
+	gpudl__cache_key_push(desc->maxAnisotropy);
+	struct gpudl__cache_entry* e = gpudl__object_cache_get(&gpudl__runtime.sampler_cache);
+	if (e->object == NULL) {
+		e->object = wgpuDeviceCreateSampler(gpudl__runtime.wgpu_device, desc);
+		assert(e->object != NULL);
+	}
+	return e->object;
+}
+
+WGPUBindGroupLayout gpudl_get_bind_group_layout(const WGPUBindGroupLayoutDescriptor* desc)
+{
+	assert((desc->nextInChain == NULL) && "chained bind group layout descriptors are not cacheable");
+	gpudl__cache_key_reset();
+	gpudl__cache_key_push(desc->entryCount);
+	for (int i = 0; i < desc->entryCount; i++) {
+		const WGPUBindGroupLayoutEntry* entry = &desc->entries[i];
+		assert((entry->nextInChain == NULL) && "chained bind group layout entries are not cacheable");
+		gpudl__cache_key_push(entry->binding);
+		gpudl__cache_key_push(entry->visibility);
+		gpudl__cache_key_push(entry->buffer.type);
+		gpudl__cache_key_push(entry->buffer.hasDynamicOffset);
+		gpudl__cache_key_push(entry->buffer.minBindingSize);
+		gpudl__cache_key_push(entry->sampler.type);
+		gpudl__cache_key_push(entry->texture.sampleType);
+		gpudl__cache_key_push(entry->texture.viewDimension);
+		gpudl__cache_key_push(entry->texture.multisampled);
+		gpudl__cache_key_push(entry->storageTexture.access);
+		gpudl__cache_key_push(entry->storageTexture.format);
+		gpudl__cache_key_push(entry->storageTexture.viewDimension);
+	}
+	struct gpudl__cache_entry* e = gpudl__object_cache_get(&gpudl__runtime.bind_group_layout_cache);
+	if (e->object == NULL) {
+		e->object = wgpuDeviceCreateBindGroupLayout(gpudl__runtime.wgpu_device, desc);
+		assert(e->object != NULL);
+	}
+	return e->object;
+}
+
+WGPUBindGroup gpudl_get_bind_group(const WGPUBindGroupDescriptor* desc)
+{
+	assert((desc->nextInChain == NULL) && "chained bind group descriptors are not cacheable");
+	gpudl__cache_key_reset();
+	gpudl__cache_key_push_ptr(desc->layout);
+	gpudl__cache_key_push(desc->entryCount);
+	for (int i = 0; i < desc->entryCount; i++) {
+		const WGPUBindGroupEntry* entry = &desc->entries[i];
+		assert((entry->nextInChain == NULL) && "chained bind group entries are not cacheable");
+		gpudl__cache_key_push(entry->binding);
+		gpudl__cache_key_push_ptr(entry->buffer);
+		gpudl__cache_key_push(entry->offset);
+		gpudl__cache_key_push(entry->size);
+		gpudl__cache_key_push_ptr(entry->sampler);
+		gpudl__cache_key_push_ptr(entry->textureView);
+	}
+	struct gpudl__cache_entry* e = gpudl__object_cache_get(&gpudl__runtime.bind_group_cache);
+	if (e->object == NULL) {
+		e->object = wgpuDeviceCreateBindGroup(gpudl__runtime.wgpu_device, desc);
+		assert(e->object != NULL);
+	}
+	return e->object;
+}
+
+void gpudl_forget_bind_groups_using(const void* resource)
+{
+	gpudl__object_cache_remove_if(&gpudl__runtime.bind_group_cache, gpudl__bind_group_uses, resource, gpudl__drop_bind_group);
+}
+
+void gpudl_get_object_cache_stats(struct gpudl_object_cache_stats* samplers, struct gpudl_object_cache_stats* bind_group_layouts, struct gpudl_object_cache_stats* bind_groups)
+{
+	if (samplers) *samplers = gpudl__runtime.sampler_cache.stats;
+	if (bind_group_layouts) *bind_group_layouts = gpudl__runtime.bind_group_layout_cache.stats;
+	if (bind_groups) *bind_groups = gpudl__runtime.bind_group_cache.stats;
+}
+
+static void gpudl__drop_render_bundle(void* object)
+{
+	if (wgpuRenderBundleDrop) wgpuRenderBundleDrop(object);
+}
+
+static int gpudl__bundle_is_stale(struct gpudl__cache_entry* e, const void* ctx)
+{
+	return (gpudl__runtime.frame_counter - e->last_used_frame) > GPUDL_BIND_GROUP_CACHE_MAX_AGE;
+}
+
+// bundle keys: bundle handle, then the variant words
+static int gpudl__bundle_key_is(struct gpudl__cache_entry* e, const void* ctx)
+{
+	return e->key[0] == *(const uint64_t*)ctx;
+}
+
+static int gpudl__bundle_uses(struct gpudl__cache_entry* e, const void* resource)
+{
+	const uint64_t r = (uint64_t)(uintptr_t)resource;
+	for (int i = 1; i < e->key_len; i++) {
+		if (e->key[i] == r) return 1;
+	}
+	return 0;
+}
+
+// the bind group cache may drop a bind group that a variant refers to; a
+// new one at the same address must not replay the old recording
+static void gpudl__forget_bundles_using(const void* resource)
+{
+	gpudl__object_cache_remove_if(&gpudl__runtime.bundle_cache, gpudl__bundle_uses, resource, gpudl__drop_render_bundle);
+}
+
+static void gpudl__evict_bundles(void)
+{
+	gpudl__object_cache_remove_if(&gpudl__runtime.bundle_cache, gpudl__bundle_is_stale, NULL, gpudl__drop_render_bundle);
+}
+
+int gpudl_bundle_create(gpudl_record_bundle_func record, void* userdata)
+{
+	for (int i = 0; i < GPUDL__MAX_BUNDLES; i++) {
+		struct gpudl__bundle* b = &gpudl__runtime.bundles[i];
+		if (b->record != NULL) continue;
+		b->record = record;
+		b->userdata = userdata;
+		return i+1;
+	}
+	assert(!"too many bundles");
+	return 0;
+}
+
+static struct gpudl__bundle* gpudl__get_bundle(int bundle)
+{
+	assert((1 <= bundle && bundle <= GPUDL__MAX_BUNDLES) && "invalid bundle");
+	struct gpudl__bundle* b = &gpudl__runtime.bundles[bundle-1];
+	assert((b->record != NULL) && "invalid bundle");
+	return b;
+}
+
+void gpudl_bundle_invalidate(int bundle)
+{
+	gpudl__get_bundle(bundle);
+	const uint64_t key = bundle;
+	gpudl__object_cache_remove_if(&gpudl__runtime.bundle_cache, gpudl__bundle_key_is, &key, gpudl__drop_render_bundle);
+}
+
+void gpudl_bundle_destroy(int bundle)
+{
+	gpudl_bundle_invalidate(bundle);
+	memset(gpudl__get_bundle(bundle), 0, sizeof(struct gpudl__bundle));
+}
+
+void gpudl_bundle_execute(int bundle, WGPURenderPassEncoder pass, const uint64_t* variant, int n_variant)
+{
+	struct gpudl__bundle* b = gpudl__get_bundle(bundle);
+	gpudl__cache_key_reset();
+	gpudl__cache_key_push(bundle);
+	for (int i = 0; i < n_variant; i++) gpudl__cache_key_push(variant[i]);
+	struct gpudl__cache_entry* e = gpudl__object_cache_get(&gpudl__runtime.bundle_cache);
+	if (e->object == NULL) {
+		WGPURenderBundleEncoder encoder = wgpuDeviceCreateRenderBundleEncoder(gpudl__runtime.wgpu_device, &(WGPURenderBundleEncoderDescriptor){
+			.label = "gpudl bundle",
+			.colorFormatsCount = 1,
+			.colorFormats = &gpudl__runtime.wgpu_swap_chain_format,
+			.depthStencilFormat = WGPUTextureFormat_Undefined,
+			.sampleCount = 1,
+		});
+		assert(encoder != NULL);
+		b->record(encoder, variant, n_variant, b->userdata);
+		e->object = wgpuRenderBundleEncoderFinish(encoder, &(WGPURenderBundleDescriptor){0});
+		assert(e->object != NULL);
+	}
+	WGPURenderBundle render_bundle = e->object;
+	wgpuRenderPassEncoderExecuteBundles(pass, 1, &render_bundle);
+}
+
+void gpudl_get_bundle_stats(struct gpudl_object_cache_stats* stats)
+{
+	*stats = gpudl__runtime.bundle_cache.stats;
+}
+
+static void gpudl__uniform_ring_release(void)
+{
+	for (int i = 0; i < GPUDL_MAX_FRAMES_IN_FLIGHT; i++) {
+		WGPUBuffer buffer = gpudl__runtime.uniform_buffers[i];
+		if (buffer == NULL) continue;
+		gpudl_forget_bind_groups_using(buffer);
+		wgpuBufferDestroy(buffer);
+		gpudl__runtime.uniform_buffers[i] = NULL;
+	}
+	free(gpudl__runtime.uniform_shadow);
+	gpudl__runtime.uniform_shadow = NULL;
+	gpudl__runtime.uniform_capacity = 0;
+}
+
+void gpudl_set_uniform_ring_size(size_t size)
+{
+	assert((gpudl__runtime.rendering_window_id == 0) && "cannot resize the uniform ring while rendering");
+	gpudl__uniform_ring_release();
+	gpudl__runtime.uniform_ring_size = size;
+}
+
+// called by gpudl_render_begin(); allocations start over in the new slot
+static void gpudl__uniform_ring_begin(void)
+{
+	gpudl__runtime.uniform_used = 0;
+	gpudl__runtime.uniform_uploaded = 0;
+}
+
+void* gpudl_alloc_uniforms(size_t size, uint32_t* dynamic_offset)
+{
+	assert((gpudl__runtime.rendering_window_id > 0) && "uniforms can only be allocated between gpudl_render_begin()/end()");
+	if (gpudl__runtime.uniform_shadow == NULL) {
+		if (gpudl__runtime.uniform_ring_size == 0) gpudl__runtime.uniform_ring_size = GPUDL_UNIFORM_RING_SIZE;
+		WGPUSupportedLimits supported = {0};
+		wgpuDeviceGetLimits(gpudl__runtime.wgpu_device, &supported);
+		gpudl__runtime.uniform_align = supported.limits.minUniformBufferOffsetAlignment > 0 ? supported.limits.minUniformBufferOffsetAlignment : 256;
+		gpudl__runtime.uniform_capacity = gpudl__runtime.uniform_ring_size;
+		gpudl__runtime.uniform_shadow = malloc(gpudl__runtime.uniform_capacity);
+		assert(gpudl__runtime.uniform_shadow != NULL);
+	}
+	const int slot = gpudl__runtime.frame_slot;
+	if (gpudl__runtime.uniform_buffers[slot] == NULL) {
+		gpudl__runtime.uniform_buffers[slot] = wgpuDeviceCreateBuffer(gpudl__runtime.wgpu_device, &(WGPUBufferDescriptor){
+			.label = "gpudl uniform ring",
+			.usage = WGPUBufferUsage_Uniform | WGPUBufferUsage_CopyDst,
+			.size = gpudl__runtime.uniform_capacity,
+		});
+		assert(gpudl__runtime.uniform_buffers[slot] != NULL);
+	}
+
+	assert(!gpudl__runtime.uniform_uploaded && "uniforms already uploaded this frame");
+	const size_t align = gpudl__runtime.uniform_align;
+	const size_t offset = (gpudl__runtime.uniform_used + align - 1) & ~(align - 1);
+	if (offset + size > gpudl__runtime.uniform_capacity) {
+		fprintf(stderr, "uniform ring overflow (%zu bytes per frame); see gpudl_set_uniform_ring_size()\n", gpudl__runtime.uniform_capacity);
+		abort();
+	}
+	gpudl__runtime.uniform_used = offset + size;
+	*dynamic_offset = offset;
+	return (uint8_t*)gpudl__runtime.uniform_shadow + offset;
+}
+
+WGPUBuffer gpudl_get_uniform_buffer(void)
+{
+	assert((gpudl__runtime.uniform_buffers[gpudl__runtime.frame_slot] != NULL) && "no uniforms allocated yet");
+	return gpudl__runtime.uniform_buffers[gpudl__runtime.frame_slot];
+}
+
+void gpudl_upload_uniforms(void)
+{
+	if (gpudl__runtime.uniform_used == 0 || gpudl__runtime.uniform_uploaded) return;
+	// (wgpuQueueWriteBuffer() wants sizes in multiples of 4)
+	const size_t size = (gpudl__runtime.uniform_used + 3) & ~(size_t)3;
+	wgpuQueueWriteBuffer(gpudl__runtime.wgpu_queue, gpudl__runtime.uniform_buffers[gpudl__runtime.frame_slot], 0, gpudl__runtime.uniform_shadow, size);
+	gpudl__runtime.uniform_uploaded = 1;
+}
+
+int gpudl_map_file(const char* path, struct gpudl_mapped_file* file)
+{
+	memset(file, 0, sizeof *file);
+	const int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return 0;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		close(fd);
+		return 0;
+	}
+	if (st.st_size > 0) {
+		void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			fprintf(stderr, "%s: mmap: %s\n", path, strerror(errno));
+			close(fd);
+			return 0;
+		}
+		madvise(data, st.st_size, MADV_SEQUENTIAL);
+		file->data = data;
+		file->size = st.st_size;
+	}
+	// (the mapping outlives the fd)
+	close(fd);
+	return 1;
+}
+
+void gpudl_unmap_file(struct gpudl_mapped_file* file)
+{
+	if (file->data) munmap((void*)file->data, file->size);
+	memset(file, 0, sizeof *file);
+}
+
+// madvise() wants page aligned addresses; this rounds [offset;offset+size)
+// outwards (grow=1) or inwards (grow=0). returns 0 if nothing is left
+static int gpudl__file_page_range(const struct gpudl_mapped_file* file, size_t offset, size_t size, int grow, uint8_t** start, size_t* length)
+{
+	const size_t page = sysconf(_SC_PAGESIZE);
+	if (offset >= file->size) return 0;
+	if (size > file->size - offset) size = file->size - offset;
+	size_t begin = offset;
+	size_t end = offset + size;
+	if (grow) {
+		begin &= ~(page-1);
+		end = (end + page - 1) & ~(page-1);
+	} else {
+		begin = (begin + page - 1) & ~(page-1);
+		// (the tail of the last page past the end of the file is
+		// part of the mapping)
+		if (end != file->size) end &= ~(page-1);
+		else end = (end + page - 1) & ~(page-1);
+	}
+	if (end <= begin) return 0;
+	*start = (uint8_t*)file->data + begin;
+	*length = end - begin;
+	return 1;
+}
+
+void gpudl_prefetch_file(const struct gpudl_mapped_file* file, size_t offset, size_t size)
+{
+	uint8_t* start;
+	size_t length;
+	if (gpudl__file_page_range(file, offset, size, 1, &start, &length)) madvise(start, length, MADV_WILLNEED);
+}
+
+void gpudl_upload_file_to_buffer(const struct gpudl_mapped_file* file, size_t offset, size_t size, WGPUBuffer buffer, uint64_t buffer_offset)
+{
+	assert((offset + size <= file->size) && "range is outside the file");
+	assert(((size & 3) == 0 && (buffer_offset & 3) == 0) && "size and buffer offset must be multiples of 4");
+	// wgpuQueueWriteBuffer() copies straight from the page cache into
+	// wgpu's staging memory. chunks are prefetched one ahead so the
+	// kernel reads while we copy, and dropped behind so that huge files
+	// don't pile up in our RSS (they stay in the page cache)
+	gpudl_prefetch_file(file, offset, size < GPUDL_FILE_UPLOAD_CHUNK ? size : GPUDL_FILE_UPLOAD_CHUNK);
+	size_t done = 0;
+	int n_chunks = 0;
+	while (done < size) {
+		// wgpu only releases the staging memory of a write after the
+		// submit following it is done, so submit each chunk (an empty
+		// submit flushes pending writes) and wait for them every other
+		// chunk; that keeps at most two chunks staged while still
+		// copying one while the GPU takes the other
+		if (n_chunks > 0 && (n_chunks & 1) == 0) wgpuDevicePoll(gpudl__runtime.wgpu_device, true);
+		const size_t n = (size - done) < GPUDL_FILE_UPLOAD_CHUNK ? (size - done) : GPUDL_FILE_UPLOAD_CHUNK;
+		if (done + n < size) gpudl_prefetch_file(file, offset + done + n, GPUDL_FILE_UPLOAD_CHUNK);
+		wgpuQueueWriteBuffer(gpudl__runtime.wgpu_queue, buffer, buffer_offset + done, file->data + offset + done, n);
+		uint8_t* start;
+		size_t length;
+		if (gpudl__file_page_range(file, offset + done, n, 0, &start, &length)) madvise(start, length, MADV_DONTNEED);
+		wgpuQueueSubmit(gpudl__runtime.wgpu_queue, 0, NULL);
+		n_chunks++;
+		done += n;
+	}
+}
+
+WGPUShaderModule gpudl_load_wgsl(const char* path)
+{
+	struct gpudl_mapped_file file;
+	if (!gpudl_map_file(path, &file)) return NULL;
+	// mappings are zero-filled past the end of the file, so the code is
+	// already NUL terminated unless it ends exactly on a page boundary
+	const size_t page = sysconf(_SC_PAGESIZE);
+	char* copy = NULL;
+	const char* code = (const char*)file.data;
+	if (file.size == 0 || (file.size & (page-1)) == 0) {
+		copy = malloc(file.size + 1);
+		assert(copy != NULL);
+		if (file.size > 0) memcpy(copy, file.data, file.size);
+		copy[file.size] = 0;
+		code = copy;
+	}
+	WGPUShaderModule module = wgpuDeviceCreateShaderModule(gpudl__runtime.wgpu_device, &(WGPUShaderModuleDescriptor){
+		.nextInChain = (const WGPUChainedStruct*)&(WGPUShaderModuleWGSLDescriptor){
+			.chain = (WGPUChainedStruct){ .sType = WGPUSType_ShaderModuleWGSLDescriptor },
+			.code = code,
+		},
+		.label = path,
+	});
+	free(copy);
+	gpudl_unmap_file(&file);
+	return module;
+}
+
+static const char* gpudl__mip_shader =
+	"@group(0) @binding(0) var src: texture_2d<f32>;\n"
+	"@group(0) @binding(1) var dst: texture_storage_2d<rgba8unorm, write>;\n"
+	"@compute @workgroup_size(8, 8)\n"
+	"fn main(@builtin(global_invocation_id) id: vec3<u32>) {\n"
+	"	let size = vec2<u32>(textureDimensions(dst));\n"
+	"	if (id.x >= size.x || id.y >= size.y) { return; }\n"
+	"	let last = vec2<i32>(textureDimensions(src)) - vec2<i32>(1, 1);\n"
+	"	let p = min(vec2<i32>(id.xy) * 2, last);\n"
+	"	let q = min(p + vec2<i32>(1, 1), last);\n"
+	"	let c = textureLoad(src, p, 0) + textureLoad(src, vec2<i32>(q.x, p.y), 0)\n"
+	"		+ textureLoad(src, vec2<i32>(p.x, q.y), 0) + textureLoad(src, q, 0);\n"
+	"	textureStore(dst, vec2<i32>(id.xy), c * 0.25);\n"
+	"}\n";
+
+static int gpudl__mip_size(int size, int mip)
+{
+	const int s = size >> mip;
+	return s > 0 ? s : 1;
+}
+
+// 2×2 box filter (XXX in sRGB space, i.e. slightly too dark)
+static void gpudl__downsample_rgba8(const uint8_t* src, int src_width, int src_height, uint8_t* dst, int width, int height)
+{
+	for (int y = 0; y < height; y++) {
+		const int y0 = 2*y < src_height ? 2*y : src_height-1;
+		const int y1 = 2*y+1 < src_height ? 2*y+1 : src_height-1;
+		for (int x = 0; x < width; x++) {
+			const int x0 = 2*x < src_width ? 2*x : src_width-1;
+			const int x1 = 2*x+1 < src_width ? 2*x+1 : src_width-1;
+			const uint8_t* a = &src[(y0*src_width + x0)*4];
+			const uint8_t* b = &src[(y0*src_width + x1)*4];
+			const uint8_t* c = &src[(y1*src_width + x0)*4];
+			const uint8_t* d = &src[(y1*src_width + x1)*4];
+			for (int i = 0; i < 4; i++) *(dst++) = (a[i] + b[i] + c[i] + d[i] + 2) >> 2;
+		}
+	}
+}
+
+// tail mips are the ones made on the worker and uploaded first, so that
+// something is resident right away: [tail_mip;n_mips), but never the base
+// mip, which is always uploaded from the decoded pixels
+static void gpudl__stream_make_tail(struct gpudl__streamed_texture* t)
+{
+	const int w = t->width;
+	const int h = t->height;
+	t->n_mips = 1;
+	while (gpudl__mip_size(w, t->n_mips-1) > 1 || gpudl__mip_size(h, t->n_mips-1) > 1) t->n_mips++;
+	t->tail_mip = 1;
+	while (t->tail_mip < t->n_mips && (gpudl__mip_size(w, t->tail_mip) > GPUDL_STREAM_TAIL_SIZE || gpudl__mip_size(h, t->tail_mip) > GPUDL_STREAM_TAIL_SIZE)) t->tail_mip++;
+
+	size_t tail_size = 0;
+	for (int mip = t->tail_mip; mip < t->n_mips; mip++) {
+		tail_size += (size_t)gpudl__mip_size(w, mip) * gpudl__mip_size(h, mip) * 4;
+	}
+	t->tail_pixels = tail_size > 0 ? malloc(tail_size) : NULL;
+
+	const uint8_t* src = t->pixels;
+	uint8_t* scratch = NULL;
+	uint8_t* tail = t->tail_pixels;
+	for (int mip = 1; mip < t->n_mips; mip++) {
+		const int mw = gpudl__mip_size(w, mip);
+		const int mh = gpudl__mip_size(h, mip);
+		uint8_t* dst;
+		if (mip >= t->tail_mip) {
+			dst = tail;
+			tail += (size_t)mw * mh * 4;
+		} else {
+			// only needed for getting to the tail
+			dst = malloc((size_t)mw * mh * 4);
+		}
+		gpudl__downsample_rgba8(src, gpudl__mip_size(w, mip-1), gpudl__mip_size(h, mip-1), dst, mw, mh);
+		free(scratch);
+		scratch = (mip < t->tail_mip) ? dst : NULL;
+		src = dst;
+	}
+	free(scratch);
+}
+
+// picks the oldest queued texture; called with stream_mutex held
+static struct gpudl__streamed_texture* gpudl__stream_next_queued(void)
+{
+	struct gpudl__streamed_texture* next = NULL;
+	for (int i = 0; i < GPUDL_MAX_STREAMED_TEXTURES; i++) {
+		struct gpudl__streamed_texture* t = &gpudl__runtime.streamed_textures[i];
+		if (t->state != GPUDL__STREAM_QUEUED) continue;
+		if (next == NULL || t->seq < next->seq) next = t;
+	}
+	return next;
+}
+
+static void gpudl__stream_map_file(struct gpudl__streamed_texture* t)
+{
+	if (!gpudl_map_file(t->path, &t->file)) return;
+	const size_t size = (size_t)t->width * t->height * 4;
+	if (t->file_offset + size > t->file.size) {
+		fprintf(stderr, "%s: too short for %d×%d RGBA8 pixels at offset %zu\n", t->path, t->width, t->height, t->file_offset);
+		gpudl_unmap_file(&t->file);
+		return;
+	}
+	// making the small mips reads every page anyway, so it might as
+	// well start early
+	gpudl_prefetch_file(&t->file, t->file_offset, size);
+	t->pixels = (uint8_t*)t->file.data + t->file_offset;
+}
+
+static void gpudl__stream_free_pixels(struct gpudl__streamed_texture* t)
+{
+	if (t->path) {
+		gpudl_unmap_file(&t->file);
+	} else {
+		free(t->pixels);
+	}
+	t->pixels = NULL;
+}
+
+static void* gpudl__stream_worker(void* arg)
+{
+	pthread_mutex_lock(&gpudl__runtime.stream_mutex);
+	for (;;) {
+		struct gpudl__streamed_texture* t;
+		while (!gpudl__runtime.stream_quit && (t = gpudl__stream_next_queued()) == NULL) {
+			pthread_cond_wait(&gpudl__runtime.stream_cond, &gpudl__runtime.stream_mutex);
+		}
+		if (gpudl__runtime.stream_quit) break;
+		t->state = GPUDL__STREAM_DECODING;
+		pthread_mutex_unlock(&gpudl__runtime.stream_mutex);
+
+		// the texture is ours until it's DECODED, except for the
+		// free_requested flag
+		if (t->path) {
+			gpudl__stream_map_file(t);
+		} else {
+			t->pixels = t->decode(t->userdata, &t->width, &t->height);
+		}
+		if (t->pixels != NULL) gpudl__stream_make_tail(t);
+
+		pthread_mutex_lock(&gpudl__runtime.stream_mutex);
+		if (t->free_requested) {
+			gpudl__stream_free_pixels(t);
+			free(t->path);
+			free(t->tail_pixels);
+			memset(t, 0, sizeof *t);
+		} else {
+			t->state = (t->pixels != NULL) ? GPUDL__STREAM_DECODED : GPUDL__STREAM_FAILED;
+		}
+	}
+	pthread_mutex_unlock(&gpudl__runtime.stream_mutex);
+	return NULL;
+}
+
+static int gpudl__stream_get_state(struct gpudl__streamed_texture* t)
+{
+	pthread_mutex_lock(&gpudl__runtime.stream_mutex);
+	const int state = t->state;
+	pthread_mutex_unlock(&gpudl__runtime.stream_mutex);
+	return state;
+}
+
+static void gpudl__stream_set_state(struct gpudl__streamed_texture* t, int state)
+{
+	pthread_mutex_lock(&gpudl__runtime.stream_mutex);
+	t->state = state;
+	pthread_mutex_unlock(&gpudl__runtime.stream_mutex);
+}
+
+static struct gpudl__streamed_texture* gpudl__get_streamed_texture(int handle)
+{
+	assert((1 <= handle && handle <= GPUDL_MAX_STREAMED_TEXTURES) && "invalid streamed texture handle");
+	return &gpudl__runtime.streamed_textures[handle-1];
+}
+
+static int gpudl__stream_texture(gpudl_decode_func decode, void* userdata, const char* path, size_t offset, int width, int height)
+{
+	if (!gpudl__runtime.stream_worker_running) {
+		pthread_mutex_init(&gpudl__runtime.stream_mutex, NULL);
+		pthread_cond_init(&gpudl__runtime.stream_cond, NULL);
+		const int err = pthread_create(&gpudl__runtime.stream_worker, NULL, gpudl__stream_worker, NULL);
+		assert((err == 0) && "pthread_create() failed");
+		gpudl__runtime.stream_worker_running = 1;
+	}
+
+	pthread_mutex_lock(&gpudl__runtime.stream_mutex);
+	int handle = 0;
+	for (int i = 0; i < GPUDL_MAX_STREAMED_TEXTURES; i++) {
+		struct gpudl__streamed_texture* t = &gpudl__runtime.streamed_textures[i];
+		if (t->state != GPUDL__STREAM_FREE) continue;
+		memset(t, 0, sizeof *t);
+		t->state = GPUDL__STREAM_QUEUED;
+		t->seq = ++gpudl__runtime.stream_seq;
+		t->decode = decode;
+		t->userdata = userdata;
+		t->path = path ? strdup(path) : NULL;
+		t->file_offset = offset;
+		t->width = width;
+		t->height = height;
+		t->resident_mip = -1;
+		handle = i+1;
+		break;
+	}
+	pthread_cond_signal(&gpudl__runtime.stream_cond);
+	pthread_mutex_unlock(&gpudl__runtime.stream_mutex);
+	assert((handle > 0) && "too many streamed textures; see GPUDL_MAX_STREAMED_TEXTURES");
+	return handle;
+}
+
+int gpudl_stream_texture(gpudl_decode_func decode, void* userdata)
+{
+	return gpudl__stream_texture(decode, userdata, NULL, 0, 0, 0);
+}
+
+int gpudl_stream_texture_file(const char* path, size_t offset, int width, int height)
+{
+	assert((width > 0 && height > 0) && "invalid texture size");
+	return gpudl__stream_texture(NULL, NULL, path, offset, width, height);
+}
+
+WGPUTextureView gpudl_get_streamed_texture(int handle, int* resident_mip)
+{
+	struct gpudl__streamed_texture* t = gpudl__get_streamed_texture(handle);
+	if (resident_mip) *resident_mip = (gpudl__stream_get_state(t) == GPUDL__STREAM_FAILED) ? -2 : t->resident_mip;
+	return t->view;
+}
+
+static void gpudl__stream_release_gpu(struct gpudl__streamed_texture* t)
+{
+	if (t->view) {
+		gpudl_forget_bind_groups_using(t->view);
+		wgpuTextureViewDrop(t->view);
+	}
+	if (t->texture) {
+		wgpuTextureDestroy(t->texture);
+		wgpuTextureDrop(t->texture);
+	}
+}
+
+void gpudl_free_streamed_texture(int handle)
+{
+	struct gpudl__streamed_texture* t = gpudl__get_streamed_texture(handle);
+	pthread_mutex_lock(&gpudl__runtime.stream_mutex);
+	assert((t->state != GPUDL__STREAM_FREE && t->state != GPUDL__STREAM_FREEING && !t->free_requested) && "streamed texture already freed");
+	if (t->state == GPUDL__STREAM_DECODING) {
+		// the worker frees it when it's done decoding
+		t->free_requested = 1;
+		pthread_mutex_unlock(&gpudl__runtime.stream_mutex);
+		return;
+	}
+	// out of reach of the worker (which only picks QUEUED) and of
+	// gpudl__stream_texture() (which only reuses FREE) from here on
+	t->state = GPUDL__STREAM_FREEING;
+	pthread_mutex_unlock(&gpudl__runtime.stream_mutex);
+	gpudl__stream_release_gpu(t);
+	gpudl__stream_free_pixels(t);
+	free(t->path);
+	free(t->tail_pixels);
+	gpudl__stream_set_state(t, GPUDL__STREAM_FREE);
+}
+
+void gpudl_set_stream_upload_budget(size_t bytes_per_frame)
+{
+	gpudl__runtime.stream_upload_budget = bytes_per_frame;
+}
+
+// staging buffers of one gpudl_pump_streamed_textures() call; dropped after
+// the submit
+struct gpudl__stream_staging {
+	WGPUCommandEncoder encoder;
+	int n_buffers;
+	WGPUBuffer buffers[64];
+};
+
+static void gpudl__stream_submit(struct gpudl__stream_staging* staging)
+{
+	if (staging->encoder == NULL) return;
+	WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(staging->encoder, &(WGPUCommandBufferDescriptor){0});
+	wgpuQueueSubmit(gpudl__runtime.wgpu_queue, 1, &cmd);
+	for (int i = 0; i < staging->n_buffers; i++) {
+		// XXX without wgpuBufferDrop() the handle leaks, but the
+		// memory goes once the submit is done
+		if (wgpuBufferDrop) {
+			wgpuBufferDrop(staging->buffers[i]);
+		} else {
+			wgpuBufferDestroy(staging->buffers[i]);
+		}
+	}
+	memset(staging, 0, sizeof *staging);
+}
+
+// copies rows [y;y+height) of a mip through a staging buffer
+static void gpudl__stream_copy(struct gpudl__stream_staging* staging, WGPUTexture texture, int mip, int y, int width, int height, const uint8_t* pixels)
+{
+	const int n_max = sizeof(staging->buffers) / sizeof(staging->buffers[0]);
+	if (staging->n_buffers == n_max) gpudl__stream_submit(staging);
+	// bytesPerRow must be a multiple of 256
+	const size_t row_size = (size_t)width * 4;
+	const size_t pitch = (row_size + 255) & ~(size_t)255;
+	const size_t size = pitch * height;
+	WGPUBuffer buffer = wgpuDeviceCreateBuffer(gpudl__runtime.wgpu_device, &(WGPUBufferDescriptor){
+		.label = "gpudl texture staging",
+		.usage = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc,
+		.size = size,
+		.mappedAtCreation = true,
+	});
+	assert(buffer != NULL);
+	uint8_t* dst = wgpuBufferGetMappedRange(buffer, 0, size);
+	assert(dst != NULL);
+	for (int row = 0; row < height; row++) {
+		memcpy(dst + row*pitch, pixels + row*row_size, row_size);
+	}
+	wgpuBufferUnmap(buffer);
+
+	if (staging->encoder == NULL) {
+		staging->encoder = wgpuDeviceCreateCommandEncoder(gpudl__runtime.wgpu_device, &(WGPUCommandEncoderDescriptor){.label = "gpudl texture streaming"});
+	}
+	wgpuCommandEncoderCopyBufferToTexture(
+		staging->encoder,
+		&(WGPUImageCopyBuffer){
+			.layout = (WGPUTextureDataLayout){
+				.offset = 0,
+				.bytesPerRow = pitch,
+				.rowsPerImage = height,
+			},
+			.buffer = buffer,
+		},
+		&(WGPUImageCopyTexture){
+			.texture = texture,
+			.mipLevel = mip,
+			.origin = (WGPUOrigin3D){ .x = 0, .y = y, .z = 0 },
+			.aspect = WGPUTextureAspect_All,
+		},
+		&(WGPUExtent3D){ .width = width, .height = height, .depthOrArrayLayers = 1 });
+	staging->buffers[staging->n_buffers++] = buffer;
+}
+
+static WGPUTextureView gpudl__stream_mip_view(WGPUTexture texture, int base_mip, int n_mips)
+{
+	WGPUTextureView view = wgpuTextureCreateView(texture, &(WGPUTextureViewDescriptor){
+		.format = WGPUTextureFormat_RGBA8Unorm,
+		.dimension = WGPUTextureViewDimension_2D,
+		.baseMipLevel = base_mip,
+		.mipLevelCount = n_mips,
+		.baseArrayLayer = 0,
+		.arrayLayerCount = 1,
+		.aspect = WGPUTextureAspect_All,
+	});
+	assert(view != NULL);
+	return view;
+}
+
+// the view only covers resident mips, so samplers never see the rest
+static void gpudl__stream_set_resident_mip(struct gpudl__streamed_texture* t, int mip)
+{
+	if (t->view) {
+		gpudl_forget_bind_groups_using(t->view);
+		wgpuTextureViewDrop(t->view);
+	}
+	t->view = gpudl__stream_mip_view(t->texture, mip, t->n_mips - mip);
+	t->resident_mip = mip;
+}
+
+// generates mips [1;end_mip) from the base mip
+static void gpudl__stream_generate_mips(struct gpudl__stream_staging* staging, struct gpudl__streamed_texture* t, int end_mip)
+{
+	if (end_mip <= 1) return;
+	WGPUDevice device = gpudl__runtime.wgpu_device;
+	if (gpudl__runtime.mip_pipeline == NULL) {
+		gpudl__runtime.mip_bind_group_layout = gpudl_get_bind_group_layout(&(WGPUBindGroupLayoutDescriptor){
+			.entryCount = 2,
+			.entries = (WGPUBindGroupLayoutEntry[]){
+				(WGPUBindGroupLayoutEntry){
+					.binding = 0,
+					.visibility = WGPUShaderStage_Compute,
+					.texture = (WGPUTextureBindingLayout){
+						.sampleType = WGPUTextureSampleType_Float,
+						.viewDimension = WGPUTextureViewDimension_2D,
+					},
+				},
+				(WGPUBindGroupLayoutEntry){
+					.binding = 1,
+					.visibility = WGPUShaderStage_Compute,
+					.storageTexture = (WGPUStorageTextureBindingLayout){
+						.access = WGPUStorageTextureAccess_WriteOnly,
+						.format = WGPUTextureFormat_RGBA8Unorm,
+						.viewDimension = WGPUTextureViewDimension_2D,
+					},
+				},
+			},
+		});
+		gpudl__runtime.mip_shader_module = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor){
+			.nextInChain = (const WGPUChainedStruct*)&(WGPUShaderModuleWGSLDescriptor){
+				.chain = (WGPUChainedStruct){ .sType = WGPUSType_ShaderModuleWGSLDescriptor },
+				.code = gpudl__mip_shader,
+			},
+			.label = "gpudl mip generator",
+		});
+		assert(gpudl__runtime.mip_shader_module != NULL);
+		gpudl__runtime.mip_pipeline_layout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor){
+			.bindGroupLayoutCount = 1,
+			.bindGroupLayouts = &gpudl__runtime.mip_bind_group_layout,
+		});
+		gpudl__runtime.mip_pipeline = wgpuDeviceCreateComputePipeline(device, &(WGPUComputePipelineDescriptor){
+			.label = "gpudl mip generator",
+			.layout = gpudl__runtime.mip_pipeline_layout,
+			.compute = (WGPUProgrammableStageDescriptor){
+				.module = gpudl__runtime.mip_shader_module,
+				.entryPoint = "main",
+			},
+		});
+		assert(gpudl__runtime.mip_pipeline != NULL);
+	}
+
+	if (staging->encoder == NULL) {
+		staging->encoder = wgpuDeviceCreateCommandEncoder(device, &(WGPUCommandEncoderDescriptor){.label = "gpudl texture streaming"});
+	}
+	WGPUComputePassEncoder pass = wgpuCommandEncoderBeginComputePass(staging->encoder, &(WGPUComputePassDescriptor){.label = "gpudl mips"});
+	wgpuComputePassEncoderSetPipeline(pass, gpudl__runtime.mip_pipeline);
+	for (int mip = 1; mip < end_mip; mip++) {
+		// views and bind groups are refcounted by wgpu, so they can be
+		// dropped right after recording
+		WGPUTextureView src = gpudl__stream_mip_view(t->texture, mip-1, 1);
+		WGPUTextureView dst = gpudl__stream_mip_view(t->texture, mip, 1);
+		WGPUBindGroup bind_group = wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor){
+			.layout = gpudl__runtime.mip_bind_group_layout,
+			.entryCount = 2,
+			.entries = (WGPUBindGroupEntry[]){
+				(WGPUBindGroupEntry){ .binding = 0, .textureView = src },
+				(WGPUBindGroupEntry){ .binding = 1, .textureView = dst },
+			},
+		});
+		wgpuComputePassEncoderSetBindGroup(pass, 0, bind_group, 0, NULL);
+		const int w = gpudl__mip_size(t->width, mip);
+		const int h = gpudl__mip_size(t->height, mip);
+		wgpuComputePassEncoderDispatchWorkgroups(pass, (w+7)/8, (h+7)/8, 1);
+		wgpuBindGroupDrop(bind_group);
+		wgpuTextureViewDrop(src);
+		wgpuTextureViewDrop(dst);
+	}
+	wgpuComputePassEncoderEnd(pass);
+}
+
+void gpudl_pump_streamed_textures(void)
+{
+	// (nothing can have been decoded without a device to upload to)
+	if (!gpudl__runtime.stream_worker_running || gpudl__runtime.wgpu_device == NULL) return;
+	size_t budget = gpudl__runtime.stream_upload_budget > 0 ? gpudl__runtime.stream_upload_budget : GPUDL_STREAM_UPLOAD_BUDGET;
+	struct gpudl__stream_staging staging = {0};
+
+	for (int i = 0; i < GPUDL_MAX_STREAMED_TEXTURES && budget > 0; i++) {
+		struct gpudl__streamed_texture* t = &gpudl__runtime.streamed_textures[i];
+		const int state = gpudl__stream_get_state(t);
+
+		if (state == GPUDL__STREAM_DECODED) {
+			t->texture = wgpuDeviceCreateTexture(gpudl__runtime.wgpu_device, &(WGPUTextureDescriptor){
+				.label = "gpudl streamed texture",
+				.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst | WGPUTextureUsage_StorageBinding,
+				.dimension = WGPUTextureDimension_2D,
+				.size = (WGPUExtent3D){ .width = t->width, .height = t->height, .depthOrArrayLayers = 1 },
+				.format = WGPUTextureFormat_RGBA8Unorm,
+				.mipLevelCount = t->n_mips,
+				.sampleCount = 1,
+			});
+			assert(t->texture != NULL);
+			// the tail is tiny; it goes regardless of the budget
+			const uint8_t* tail = t->tail_pixels;
+			for (int mip = t->tail_mip; mip < t->n_mips; mip++) {
+				const int w = gpudl__mip_size(t->width, mip);
+				const int h = gpudl__mip_size(t->height, mip);
+				gpudl__stream_copy(&staging, t->texture, mip, 0, w, h, tail);
+				tail += (size_t)w * h * 4;
+			}
+			if (t->tail_mip < t->n_mips) gpudl__stream_set_resident_mip(t, t->tail_mip);
+			free(t->tail_pixels);
+			t->tail_pixels = NULL;
+			gpudl__stream_set_state(t, GPUDL__STREAM_UPLOADING);
+		}
+
+		if (gpudl__stream_get_state(t) == GPUDL__STREAM_UPLOADING) {
+			const size_t row_size = (size_t)t->width * 4;
+			int n_rows = budget / row_size;
+			if (n_rows < 1) n_rows = 1;
+			if (n_rows > t->height - t->next_row) n_rows = t->height - t->next_row;
+			gpudl__stream_copy(&staging, t->texture, 0, t->next_row, t->width, n_rows, t->pixels + t->next_row*row_size);
+			t->next_row += n_rows;
+			budget = (n_rows*row_size < budget) ? budget - n_rows*row_size : 0;
+			if (t->next_row == t->height) {
+				gpudl__stream_generate_mips(&staging, t, t->tail_mip);
+				gpudl__stream_set_resident_mip(t, 0);
+				gpudl__stream_free_pixels(t);
+				gpudl__stream_set_state(t, GPUDL__STREAM_DONE);
+			}
+		}
+	}
+
+	gpudl__stream_submit(&staging);
+}
+
+static void gpudl__stream_shutdown(void)
+{
+	if (!gpudl__runtime.stream_worker_running) return;
+	pthread_mutex_lock(&gpudl__runtime.stream_mutex);
+	gpudl__runtime.stream_quit = 1;
+	pthread_cond_broadcast(&gpudl__runtime.stream_cond);
+	pthread_mutex_unlock(&gpudl__runtime.stream_mutex);
+	pthread_join(gpudl__runtime.stream_worker, NULL);
+	for (int i = 0; i < GPUDL_MAX_STREAMED_TEXTURES; i++) {
+		struct gpudl__streamed_texture* t = &gpudl__runtime.streamed_textures[i];
+		if (t->state == GPUDL__STREAM_FREE) continue;
+		gpudl__stream_release_gpu(t);
+		gpudl__stream_free_pixels(t);
+		free(t->path);
+		free(t->tail_pixels);
+	}
+	// (the bind group layout belongs to the layout cache)
+	if (gpudl__runtime.mip_pipeline && wgpuComputePipelineDrop) wgpuComputePipelineDrop(gpudl__runtime.mip_pipeline);
+	if (gpudl__runtime.mip_pipeline_layout && wgpuPipelineLayoutDrop) wgpuPipelineLayoutDrop(gpudl__runtime.mip_pipeline_layout);
+	if (gpudl__runtime.mip_shader_module && wgpuShaderModuleDrop) wgpuShaderModuleDrop(gpudl__runtime.mip_shader_module);
+	pthread_cond_destroy(&gpudl__runtime.stream_cond);
+	pthread_mutex_destroy(&gpudl__runtime.stream_mutex);
+}
+
+static const char* gpudl__2d_shader =
+	"struct VertexOutput {\n"
+	"	@builtin(position) position: vec4<f32>,\n"
+	"	@location(0) uv: vec2<f32>,\n"
+	"	@location(1) color: vec4<f32>,\n"
+	"};\n"
+	"@vertex\n"
+	"fn vs_main(@location(0) xy: vec2<f32>, @location(1) uv: vec2<f32>, @location(2) bgra: vec4<f32>) -> VertexOutput {\n"
+	"	var out: VertexOutput;\n"
+	"	out.position = vec4<f32>(xy, 0.0, 1.0);\n"
+	"	out.uv = uv;\n"
+	"	out.color = bgra.zyxw;\n"
+	"	return out;\n"
+	"}\n"
+	"@group(0) @binding(0) var tex: texture_2d<f32>;\n"
+	"@group(0) @binding(1) var smp: sampler;\n"
+	"@fragment\n"
+	"fn fs_main(in: VertexOutput) -> @location(0) vec4<f32> {\n"
+	"	return textureSample(tex, smp, in.uv) * in.color;\n"
+	"}\n";
+
+// sort keys: layer (16 bits), pipeline (4 bits), texture (12 bits)
+#define GPUDL__2D_KEY(layer, pipeline, texture) (((uint32_t)(layer) << 16) | ((uint32_t)(pipeline) << 12) | (uint32_t)(texture))
+#define GPUDL__2D_KEY_PIPELINE(key) (((key) >> 12) & 0xf)
+#define GPUDL__2D_KEY_TEXTURE(key)  ((key) & 0xfff)
+#define GPUDL__2D_MAX_TEXTURES (1<<12)
+
+// drops everything drawn; state survives unless `state` is set
+static void gpudl__2d_reset(int state)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	r->n_vertices = 0;
+	r->n_commands = 0;
+	r->n_textures = 0;
+	r->texture = -1; // texture indices are per batch of primitives
+	if (state) {
+		r->layer = 0;
+		r->blend = GPUDL_2D_BLEND_ALPHA;
+		r->texture_view = NULL;
+	}
+}
+
+static void* gpudl__grow(void* array, int* cap, int need, size_t elem_size)
+{
+	if (need <= *cap) return array;
+	while (*cap < need) *cap = *cap > 0 ? *cap * 2 : 1024;
+	array = realloc(array, *cap * elem_size);
+	assert(array != NULL);
+	return array;
+}
+
+static void gpudl__2d_retire_buffer(WGPUBuffer buffer)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	r->retired = gpudl__grow(r->retired, &r->cap_retired, r->n_retired + 1, sizeof r->retired[0]);
+	r->retired[r->n_retired++] = buffer;
+}
+
+// called by gpudl_render_end(), when the frame's work has been submitted
+static void gpudl__2d_release_retired(void)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	for (int i = 0; i < r->n_retired; i++) {
+		wgpuBufferDestroy(r->retired[i]);
+		if (wgpuBufferDrop) wgpuBufferDrop(r->retired[i]);
+	}
+	r->n_retired = 0;
+}
+
+static void gpudl__2d_init(void)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	if (r->white_view != NULL) return;
+	WGPUDevice device = gpudl__runtime.wgpu_device;
+	assert((device != NULL) && "no wgpu device yet; open a window first");
+
+	// untextured primitives sample this, so everything goes through one
+	// shader
+	r->white_texture = wgpuDeviceCreateTexture(device, &(WGPUTextureDescriptor){
+		.label = "gpudl 2d white",
+		.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst,
+		.dimension = WGPUTextureDimension_2D,
+		.size = (WGPUExtent3D){ .width = 1, .height = 1, .depthOrArrayLayers = 1 },
+		.format = WGPUTextureFormat_RGBA8Unorm,
+		.mipLevelCount = 1,
+		.sampleCount = 1,
+	});
+	const uint32_t white = 0xffffffff;
+	wgpuQueueWriteTexture(
+		gpudl__runtime.wgpu_queue,
+		&(WGPUImageCopyTexture){ .texture = r->white_texture, .aspect = WGPUTextureAspect_All },
+		&white, sizeof white,
+		&(WGPUTextureDataLayout){ .bytesPerRow = 4, .rowsPerImage = 1 },
+		&(WGPUExtent3D){ .width = 1, .height = 1, .depthOrArrayLayers = 1 });
+	r->white_view = wgpuTextureCreateView(r->white_texture, &(WGPUTextureViewDescriptor){
+		.format = WGPUTextureFormat_RGBA8Unorm,
+		.dimension = WGPUTextureViewDimension_2D,
+		.mipLevelCount = 1,
+		.arrayLayerCount = 1,
+		.aspect = WGPUTextureAspect_All,
+	});
+
+	r->sampler = gpudl_get_sampler(&(WGPUSamplerDescriptor){
+		.addressModeU = WGPUAddressMode_ClampToEdge,
+		.addressModeV = WGPUAddressMode_ClampToEdge,
+		.addressModeW = WGPUAddressMode_ClampToEdge,
+		.magFilter = WGPUFilterMode_Linear,
+		.minFilter = WGPUFilterMode_Linear,
+		.mipmapFilter = WGPUFilterMode_Linear,
+		.lodMinClamp = 0,
+		.lodMaxClamp = 32,
+		.maxAnisotropy = 1,
+	});
+	r->bind_group_layout = gpudl_get_bind_group_layout(&(WGPUBindGroupLayoutDescriptor){
+		.entryCount = 2,
+		.entries = (WGPUBindGroupLayoutEntry[]){
+			(WGPUBindGroupLayoutEntry){
+				.binding = 0,
+				.visibility = WGPUShaderStage_Fragment,
+				.texture = (WGPUTextureBindingLayout){
+					.sampleType = WGPUTextureSampleType_Float,
+					.viewDimension = WGPUTextureViewDimension_2D,
+				},
+			},
+			(WGPUBindGroupLayoutEntry){
+				.binding = 1,
+				.visibility = WGPUShaderStage_Fragment,
+				.sampler = (WGPUSamplerBindingLayout){
+					.type = WGPUSamplerBindingType_Filtering,
+				},
+			},
+		},
+	});
+
+	r->shader_module = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor){
+		.nextInChain = (const WGPUChainedStruct*)&(WGPUShaderModuleWGSLDescriptor){
+			.chain = (WGPUChainedStruct){ .sType = WGPUSType_ShaderModuleWGSLDescriptor },
+			.code = gpudl__2d_shader,
+		},
+		.label = "gpudl 2d",
+	});
+	assert(r->shader_module != NULL);
+	r->pipeline_layout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor){
+		.bindGroupLayoutCount = 1,
+		.bindGroupLayouts = &r->bind_group_layout,
+	});
+}
+
+// pipelines are made on first use of a target format
+static struct gpudl__2d_pipelines* gpudl__2d_get_pipelines(WGPUTextureFormat format)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	for (int i = 0; i < r->n_formats; i++) {
+		if (r->formats[i].format == format) return &r->formats[i];
+	}
+	assert((r->n_formats < GPUDL__2D_MAX_FORMATS) && "too many 2d target formats; see GPUDL__2D_MAX_FORMATS");
+	struct gpudl__2d_pipelines* p = &r->formats[r->n_formats++];
+	p->format = format;
+	for (int blend = 0; blend < GPUDL_2D_BLEND_END; blend++) {
+		const WGPUBlendFactor dst_factor = (blend == GPUDL_2D_BLEND_ADD) ? WGPUBlendFactor_One : WGPUBlendFactor_OneMinusSrcAlpha;
+		p->pipelines[blend] = wgpuDeviceCreateRenderPipeline(gpudl__runtime.wgpu_device, &(WGPURenderPipelineDescriptor){
+			.label = "gpudl 2d",
+			.layout = r->pipeline_layout,
+			.vertex = (WGPUVertexState){
+				.module = r->shader_module,
+				.entryPoint = "vs_main",
+				.bufferCount = 1,
+				.buffers = &(WGPUVertexBufferLayout){
+					.arrayStride = sizeof(struct gpudl__2d_vertex),
+					.stepMode = WGPUVertexStepMode_Vertex,
+					.attributeCount = 3,
+					.attributes = (WGPUVertexAttribute[]){
+						(WGPUVertexAttribute){ .format = WGPUVertexFormat_Float32x2, .offset = 0, .shaderLocation = 0 },
+						(WGPUVertexAttribute){ .format = WGPUVertexFormat_Float32x2, .offset = 8, .shaderLocation = 1 },
+						(WGPUVertexAttribute){ .format = WGPUVertexFormat_Unorm8x4, .offset = 16, .shaderLocation = 2 },
+					},
+				},
+			},
+			.primitive = (WGPUPrimitiveState){
+				.topology = WGPUPrimitiveTopology_TriangleList,
+				.stripIndexFormat = WGPUIndexFormat_Undefined,
+				.frontFace = WGPUFrontFace_CCW,
+				.cullMode = WGPUCullMode_None,
+			},
+			.multisample = (WGPUMultisampleState){
+				.count = 1,
+				.mask = ~0,
+			},
+			.fragment = &(WGPUFragmentState){
+				.module = r->shader_module,
+				.entryPoint = "fs_main",
+				.targetCount = 1,
+				.targets = &(WGPUColorTargetState){
+					.format = format,
+					.blend = &(WGPUBlendState){
+						.color = (WGPUBlendComponent){
+							.srcFactor = WGPUBlendFactor_SrcAlpha,
+							.dstFactor = dst_factor,
+							.operation = WGPUBlendOperation_Add,
+						},
+						.alpha = (WGPUBlendComponent){
+							.srcFactor = WGPUBlendFactor_One,
+							.dstFactor = dst_factor,
+							.operation = WGPUBlendOperation_Add,
+						},
+					},
+					.writeMask = WGPUColorWriteMask_All,
+				},
+			},
+		});
+		assert(p->pipelines[blend] != NULL);
+	}
+	return p;
+}
+
+// index 0 is the white texture; textures are numbered in order of first
+// use, and there are usually few of them
+static int gpudl__2d_texture_index(WGPUTextureView texture)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	if (texture == NULL) return 0;
+	for (int i = r->n_textures-1; i >= 0; i--) {
+		if (r->textures[i] == texture) return i+1;
+	}
+	assert((r->n_textures+1 < GPUDL__2D_MAX_TEXTURES) && "too many 2d textures in one flush");
+	r->textures = gpudl__grow(r->textures, &r->cap_textures, r->n_textures + 1, sizeof r->textures[0]);
+	r->textures[r->n_textures++] = texture;
+	return r->n_textures;
+}
+
+// appends n vertices for one primitive and returns them; a primitive with
+// the same state as the previous one extends its command
+static struct gpudl__2d_vertex* gpudl__2d_emit(int n)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	assert((gpudl__runtime.rendering_window_id > 0) && "2d drawing only works between gpudl_render_begin()/end()");
+	if (r->texture < 0) r->texture = gpudl__2d_texture_index(r->texture_view);
+	const uint32_t key = GPUDL__2D_KEY(r->layer, r->blend, r->texture);
+	r->vertices = gpudl__grow(r->vertices, &r->cap_vertices, r->n_vertices + n, sizeof r->vertices[0]);
+	struct gpudl__2d_command* last = r->n_commands > 0 ? &r->commands[r->n_commands-1] : NULL;
+	if (last != NULL && last->key == key) {
+		last->n_vertices += n;
+	} else {
+		r->commands = gpudl__grow(r->commands, &r->cap_commands, r->n_commands + 1, sizeof r->commands[0]);
+		const int seq = r->n_commands++;
+		r->commands[seq] = (struct gpudl__2d_command){
+			.key = key,
+			.seq = seq,
+			.first_vertex = r->n_vertices,
+			.n_vertices = n,
+		};
+	}
+	r->stats.n_primitives++;
+	struct gpudl__2d_vertex* v = &r->vertices[r->n_vertices];
+	r->n_vertices += n;
+	return v;
+}
+
+static void gpudl__2d_quad(float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3, float u0, float v0, float u1, float v1, uint32_t argb)
+{
+	struct gpudl__2d_vertex* v = gpudl__2d_emit(6);
+	v[0] = (struct gpudl__2d_vertex){ x0, y0, u0, v0, argb };
+	v[1] = (struct gpudl__2d_vertex){ x1, y1, u1, v0, argb };
+	v[2] = (struct gpudl__2d_vertex){ x2, y2, u1, v1, argb };
+	v[3] = v[0];
+	v[4] = v[2];
+	v[5] = (struct gpudl__2d_vertex){ x3, y3, u0, v1, argb };
+}
+
+void gpudl_2d_set_layer(int layer)
+{
+	assert((0 <= layer && layer < (1<<16)) && "layer out of range");
+	gpudl__runtime.r2d.layer = layer;
+}
+
+void gpudl_2d_set_blend(enum gpudl_2d_blend blend)
+{
+	assert((0 <= blend && blend < GPUDL_2D_BLEND_END) && "invalid blend mode");
+	gpudl__runtime.r2d.blend = blend;
+}
+
+void gpudl_2d_set_texture(WGPUTextureView texture)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	if (texture == r->texture_view) return;
+	r->texture_view = texture;
+	r->texture = -1;
+}
+
+void gpudl_2d_rect(float x, float y, float w, float h, uint32_t argb)
+{
+	gpudl__2d_quad(x, y, x+w, y, x+w, y+h, x, y+h, 0, 0, 1, 1, argb);
+}
+
+void gpudl_2d_textured_rect(float x, float y, float w, float h, float u0, float v0, float u1, float v1, uint32_t argb)
+{
+	gpudl__2d_quad(x, y, x+w, y, x+w, y+h, x, y+h, u0, v0, u1, v1, argb);
+}
+
+void gpudl_2d_line(float x0, float y0, float x1, float y1, float width, uint32_t argb)
+{
+	const float dx = x1 - x0;
+	const float dy = y1 - y0;
+	const float len = sqrtf(dx*dx + dy*dy);
+	if (len == 0) return;
+	const float nx = -dy / len * width * 0.5f;
+	const float ny =  dx / len * width * 0.5f;
+	gpudl__2d_quad(x0+nx, y0+ny, x1+nx, y1+ny, x1-nx, y1-ny, x0-nx, y0-ny, 0, 0, 1, 1, argb);
+}
+
+void gpudl_2d_triangle(float x0, float y0, float x1, float y1, float x2, float y2, uint32_t argb)
+{
+	struct gpudl__2d_vertex* v = gpudl__2d_emit(3);
+	v[0] = (struct gpudl__2d_vertex){ x0, y0, 0, 0, argb };
+	v[1] = (struct gpudl__2d_vertex){ x1, y1, 0, 0, argb };
+	v[2] = (struct gpudl__2d_vertex){ x2, y2, 0, 0, argb };
+}
+
+static int gpudl__2d_command_compare(const void* a, const void* b)
+{
+	const struct gpudl__2d_command* ca = a;
+	const struct gpudl__2d_command* cb = b;
+	if (ca->key != cb->key) return ca->key < cb->key ? -1 : 1;
+	// keeps submission order within a batch
+	return ca->seq < cb->seq ? -1 : ca->seq > cb->seq ? 1 : 0;
+}
+
+void gpudl_2d_flush(WGPUCommandEncoder encoder, WGPUTextureView target, WGPUTextureFormat format, const WGPUColor* clear)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	assert((gpudl__runtime.rendering_window_id > 0) && "2d drawing only works between gpudl_render_begin()/end()");
+	struct gpudl__window* win = gpudl__get_window(gpudl__runtime.rendering_window_id);
+	gpudl__2d_init();
+	const struct gpudl__2d_pipelines* pipelines = gpudl__2d_get_pipelines(format != WGPUTextureFormat_Undefined ? format : gpudl__runtime.wgpu_swap_chain_format);
+
+	// sort by state, and build the vertex stream in that order, in
+	// window coordinates mapped to clip space
+	qsort(r->commands, r->n_commands, sizeof r->commands[0], gpudl__2d_command_compare);
+	// (+1 for padding the upload to a multiple of 4 bytes)
+	r->sorted = gpudl__grow(r->sorted, &r->cap_sorted, r->n_vertices + 1, sizeof r->sorted[0]);
+	const float sx = 2.0f / (win->width > 0 ? win->width : 1);
+	const float sy = -2.0f / (win->height > 0 ? win->height : 1);
+	int n_sorted = 0;
+	for (int i = 0; i < r->n_commands; i++) {
+		const struct gpudl__2d_command* c = &r->commands[i];
+		const struct gpudl__2d_vertex* src = &r->vertices[c->first_vertex];
+		struct gpudl__2d_vertex* dst = &r->sorted[n_sorted];
+		for (int j = 0; j < c->n_vertices; j++) {
+			dst[j] = src[j];
+			dst[j].x = src[j].x * sx - 1.0f;
+			dst[j].y = src[j].y * sy + 1.0f;
+		}
+		n_sorted += c->n_vertices;
+	}
+
+	const size_t size = (size_t)n_sorted * sizeof r->sorted[0];
+	const size_t upload_size = (size + 3) & ~(size_t)3;
+	// each window has its own buffer, because several windows can be
+	// flushed before the queue is submitted, and each flush in a frame
+	// gets its own range of it, because all writes land before any of the
+	// frame's passes run
+	if (win->r2d_vertex_buffer_used + upload_size > win->r2d_vertex_buffer_size) {
+		if (win->r2d_vertex_buffer) gpudl__2d_retire_buffer(win->r2d_vertex_buffer);
+		size_t new_size = win->r2d_vertex_buffer_size > 0 ? win->r2d_vertex_buffer_size : (1<<16);
+		while (new_size < win->r2d_vertex_buffer_used + upload_size) new_size *= 2;
+		win->r2d_vertex_buffer = wgpuDeviceCreateBuffer(gpudl__runtime.wgpu_device, &(WGPUBufferDescriptor){
+			.label = "gpudl 2d vertices",
+			.usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst,
+			.size = new_size,
+		});
+		assert(win->r2d_vertex_buffer != NULL);
+		win->r2d_vertex_buffer_size = new_size;
+		win->r2d_vertex_buffer_used = 0;
+	}
+	const size_t offset = win->r2d_vertex_buffer_used;
+	if (size > 0) wgpuQueueWriteBuffer(gpudl__runtime.wgpu_queue, win->r2d_vertex_buffer, offset, r->sorted, upload_size);
+	win->r2d_vertex_buffer_used += upload_size;
+
+	WGPURenderPassEncoder pass = wgpuCommandEncoderBeginRenderPass(encoder, &(WGPURenderPassDescriptor){
+		.label = "gpudl 2d",
+		.colorAttachmentCount = 1,
+		.colorAttachments = &(WGPURenderPassColorAttachment){
+			.view = target,
+			.loadOp = clear ? WGPULoadOp_Clear : WGPULoadOp_Load,
+			.storeOp = WGPUStoreOp_Store,
+			.clearValue = clear ? *clear : (WGPUColor){0},
+		},
+	});
+	if (size > 0) wgpuRenderPassEncoderSetVertexBuffer(pass, 0, win->r2d_vertex_buffer, offset, size);
+
+	// merge runs of commands with the same state into one draw each
+	int first = 0;
+	int bound_pipeline = -1;
+	int bound_texture = -1;
+	for (int i = 0; i < r->n_commands; ) {
+		const uint32_t key = r->commands[i].key;
+		int n = 0;
+		while (i < r->n_commands && r->commands[i].key == key) n += r->commands[i++].n_vertices;
+		const int pipeline = GPUDL__2D_KEY_PIPELINE(key);
+		const int texture = GPUDL__2D_KEY_TEXTURE(key);
+		if (pipeline != bound_pipeline) {
+			wgpuRenderPassEncoderSetPipeline(pass, pipelines->pipelines[pipeline]);
+			bound_pipeline = pipeline;
+		}
+		if (texture != bound_texture) {
+			WGPUBindGroup bind_group = gpudl_get_bind_group(&(WGPUBindGroupDescriptor){
+				.layout = r->bind_group_layout,
+				.entryCount = 2,
+				.entries = (WGPUBindGroupEntry[]){
+					(WGPUBindGroupEntry){ .binding = 0, .textureView = texture > 0 ? r->textures[texture-1] : r->white_view },
+					(WGPUBindGroupEntry){ .binding = 1, .sampler = r->sampler },
+				},
+			});
+			wgpuRenderPassEncoderSetBindGroup(pass, 0, bind_group, 0, NULL);
+			bound_texture = texture;
+		}
+		wgpuRenderPassEncoderDraw(pass, n, 1, first, 0);
+		first += n;
+		r->stats.n_draws++;
+	}
+	wgpuRenderPassEncoderEnd(pass);
+
+	r->stats.n_commands += r->n_commands;
+	r->stats.n_flushes++;
+	gpudl__2d_reset(0);
+}
+
+void gpudl_2d_get_stats(struct gpudl_2d_stats* stats)
+{
+	*stats = gpudl__runtime.r2d.stats;
+}
+
+void gpudl_2d_reset_stats(void)
+{
+	memset(&gpudl__runtime.r2d.stats, 0, sizeof gpudl__runtime.r2d.stats);
+}
+
+static void gpudl__2d_shutdown(void)
+{
+	struct gpudl__2d* r = &gpudl__runtime.r2d;
+	if (r->white_view) wgpuTextureViewDrop(r->white_view);
+	if (r->white_texture) {
+		wgpuTextureDestroy(r->white_texture);
+		wgpuTextureDrop(r->white_texture);
+	}
+	// (the sampler and bind group layout belong to the caches)
+	for (int i = 0; i < r->n_formats; i++) {
+		for (int j = 0; j < GPUDL_2D_BLEND_END; j++) {
+			if (wgpuRenderPipelineDrop) wgpuRenderPipelineDrop(r->formats[i].pipelines[j]);
+		}
+	}
+	if (r->pipeline_layout && wgpuPipelineLayoutDrop) wgpuPipelineLayoutDrop(r->pipeline_layout);
+	if (r->shader_module && wgpuShaderModuleDrop) wgpuShaderModuleDrop(r->shader_module);
+	gpudl__2d_release_retired();
+	free(r->retired);
+	free(r->vertices);
+	free(r->sorted);
+	free(r->commands);
+	free(r->textures);
+}
+
+static struct gpudl__atlas* gpudl__get_atlas(int atlas)
+{
+	assert((1 <= atlas && atlas <= GPUDL__MAX_ATLASES) && "invalid atlas");
+	struct gpudl__atlas* a = &gpudl__runtime.atlases[atlas-1];
+	assert(a->in_use && "invalid atlas");
+	return a;
+}
+
+int gpudl_atlas_create(int size, int n_layers)
+{
+	assert((size > 0 && n_layers > 0) && "invalid atlas size");
+	assert((gpudl__runtime.wgpu_device != NULL) && "no wgpu device yet; open a window first");
+	int atlas = 0;
+	for (int i = 0; i < GPUDL__MAX_ATLASES; i++) {
+		if (!gpudl__runtime.atlases[i].in_use) {
+			atlas = i+1;
+			break;
+		}
+	}
+	assert((atlas > 0) && "too many atlases");
+	struct gpudl__atlas* a = &gpudl__runtime.atlases[atlas-1];
+	memset(a, 0, sizeof *a);
+	a->in_use = 1;
+	a->size = size;
+	a->n_layers = n_layers;
+	a->texture = wgpuDeviceCreateTexture(gpudl__runtime.wgpu_device, &(WGPUTextureDescriptor){
+		.label = "gpudl atlas",
+		.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst,
+		.dimension = WGPUTextureDimension_2D,
+		.size = (WGPUExtent3D){ .width = size, .height = size, .depthOrArrayLayers = n_layers },
+		.format = WGPUTextureFormat_RGBA8Unorm,
+		.mipLevelCount = 1,
+		.sampleCount = 1,
+	});
+	assert(a->texture != NULL);
+	a->array_view = wgpuTextureCreateView(a->texture, &(WGPUTextureViewDescriptor){
+		.format = WGPUTextureFormat_RGBA8Unorm,
+		.dimension = WGPUTextureViewDimension_2DArray,
+		.mipLevelCount = 1,
+		.arrayLayerCount = n_layers,
+		.aspect = WGPUTextureAspect_All,
+	});
+	a->layers = calloc(n_layers, sizeof a->layers[0]);
+	assert(a->layers != NULL);
+	for (int i = 0; i < n_layers; i++) {
+		a->layers[i].view = wgpuTextureCreateView(a->texture, &(WGPUTextureViewDescriptor){
+			.format = WGPUTextureFormat_RGBA8Unorm,
+			.dimension = WGPUTextureViewDimension_2D,
+			.mipLevelCount = 1,
+			.baseArrayLayer = i,
+			.arrayLayerCount = 1,
+			.aspect = WGPUTextureAspect_All,
+		});
+	}
+	return atlas;
+}
+
+static void gpudl__atlas_release(struct gpudl__atlas* a)
+{
+	gpudl__object_cache_clear(&a->entries, free);
+	for (int i = 0; i < a->n_layers; i++) {
+		gpudl_forget_bind_groups_using(a->layers[i].view);
+		wgpuTextureViewDrop(a->layers[i].view);
+		free(a->layers[i].shelves);
+	}
+	free(a->layers);
+	gpudl_forget_bind_groups_using(a->array_view);
+	wgpuTextureViewDrop(a->array_view);
+	wgpuTextureDestroy(a->texture);
+	wgpuTextureDrop(a->texture);
+	memset(a, 0, sizeof *a);
+}
+
+void gpudl_atlas_destroy(int atlas)
+{
+	gpudl__atlas_release(gpudl__get_atlas(atlas));
+}
+
+WGPUTextureView gpudl_atlas_get_array_view(int atlas)
+{
+	return gpudl__get_atlas(atlas)->array_view;
+}
+
+void gpudl_atlas_get_stats(int atlas, struct gpudl_atlas_stats* stats)
+{
+	struct gpudl__atlas* a = gpudl__get_atlas(atlas);
+	*stats = a->stats;
+	stats->n_entries = a->entries.stats.n_entries;
+}
+
+static void gpudl__atlas_fill_rect(struct gpudl__atlas* a, const struct gpudl__atlas_entry* entry, struct gpudl_atlas_rect* rect)
+{
+	const float s = 1.0f / a->size;
+	rect->layer = entry->layer;
+	rect->view = a->layers[entry->layer].view;
+	rect->u0 = entry->x * s;
+	rect->v0 = entry->y * s;
+	rect->u1 = (entry->x + entry->width) * s;
+	rect->v1 = (entry->y + entry->height) * s;
+}
+
+static void gpudl__atlas_key(uint64_t key)
+{
+	gpudl__cache_key_reset();
+	gpudl__cache_key_push(key);
+}
+
+int gpudl_atlas_lookup(int atlas, uint64_t key, struct gpudl_atlas_rect* rect)
+{
+	struct gpudl__atlas* a = gpudl__get_atlas(atlas);
+	gpudl__atlas_key(key);
+	struct gpudl__cache_entry* e = gpudl__object_cache_find(&a->entries);
+	if (e == NULL) {
+		a->stats.n_misses++;
+		return 0;
+	}
+	a->stats.n_hits++;
+	struct gpudl__atlas_entry* entry = e->object;
+	a->layers[entry->layer].shelves[entry->shelf].last_used_frame = gpudl__runtime.frame_counter;
+	gpudl__atlas_fill_rect(a, entry, rect);
+	return 1;
+}
+
+static int gpudl__atlas_entry_on_shelf(struct gpudl__cache_entry* e, const void* ctx)
+{
+	const struct gpudl__atlas_entry* entry = e->object;
+	const int* where = ctx; // layer, shelf (-1=all)
+	return entry->layer == where[0] && (where[1] < 0 || entry->shelf == where[1]);
+}
+
+static void gpudl__atlas_evict(struct gpudl__atlas* a, int layer, int shelf)
+{
+	const int where[2] = { layer, shelf };
+	gpudl__object_cache_remove_if(&a->entries, gpudl__atlas_entry_on_shelf, where, free);
+	struct gpudl__atlas_layer* l = &a->layers[layer];
+	if (shelf >= 0) {
+		l->shelves[shelf].x = 0;
+	} else {
+		l->n_shelves = 0;
+		l->next_y = 0;
+	}
+	a->stats.n_evictions++;
+}
+
+// finds room for a w×h rectangle (gutter included): the best fitting shelf
+// with room left, else a new shelf, else the least recently used shelf
+// that's tall enough, else the least recently used layer. returns 0 if
+// everything is in use this frame
+static int gpudl__atlas_alloc(struct gpudl__atlas* a, int w, int h, int* layer_out, int* shelf_out)
+{
+	const uint64_t now = gpudl__runtime.frame_counter;
+	int best_layer = -1, best_shelf = -1, best_waste = 0;
+	for (int i = 0; i < a->n_layers; i++) {
+		struct gpudl__atlas_layer* l = &a->layers[i];
+		for (int j = 0; j < l->n_shelves; j++) {
+			struct gpudl__atlas_shelf* s = &l->shelves[j];
+			// don't waste more than a quarter of a shelf's height
+			if (s->height < h || s->height > h + h/4 + 4 || s->x + w > a->size) continue;
+			const int waste = s->height - h;
+			if (best_layer < 0 || waste < best_waste) {
+				best_layer = i;
+				best_shelf = j;
+				best_waste = waste;
+			}
+		}
+	}
+	if (best_layer >= 0) goto found;
+
+	// shelf heights are rounded up so that similar sizes share them
+	const int shelf_height = (h + 3) & ~3;
+	for (int i = 0; i < a->n_layers; i++) {
+		struct gpudl__atlas_layer* l = &a->layers[i];
+		if (l->next_y + shelf_height > a->size) continue;
+		l->shelves = gpudl__grow(l->shelves, &l->cap_shelves, l->n_shelves + 1, sizeof l->shelves[0]);
+		l->shelves[l->n_shelves] = (struct gpudl__atlas_shelf){ .y = l->next_y, .height = shelf_height };
+		l->next_y += shelf_height;
+		best_layer = i;
+		best_shelf = l->n_shelves++;
+		goto found;
+	}
+
+	uint64_t oldest = now;
+	for (int i = 0; i < a->n_layers; i++) {
+		struct gpudl__atlas_layer* l = &a->layers[i];
+		for (int j = 0; j < l->n_shelves; j++) {
+			struct gpudl__atlas_shelf* s = &l->shelves[j];
+			if (s->height < h || s->last_used_frame >= oldest) continue;
+			oldest = s->last_used_frame;
+			best_layer = i;
+			best_shelf = j;
+		}
+	}
+	if (best_layer >= 0) {
+		gpudl__atlas_evict(a, best_layer, best_shelf);
+		goto found;
+	}
+
+	// no shelf is tall enough; start a layer over
+	oldest = now;
+	for (int i = 0; i < a->n_layers; i++) {
+		struct gpudl__atlas_layer* l = &a->layers[i];
+		uint64_t last_used = 0;
+		for (int j = 0; j < l->n_shelves; j++) {
+			if (l->shelves[j].last_used_frame > last_used) last_used = l->shelves[j].last_used_frame;
+		}
+		if (last_used >= oldest) continue;
+		oldest = last_used;
+		best_layer = i;
+	}
+	if (best_layer < 0) return 0;
+	gpudl__atlas_evict(a, best_layer, -1);
+	struct gpudl__atlas_layer* l = &a->layers[best_layer];
+	l->shelves = gpudl__grow(l->shelves, &l->cap_shelves, 1, sizeof l->shelves[0]);
+	l->shelves[0] = (struct gpudl__atlas_shelf){ .y = 0, .height = shelf_height };
+	l->n_shelves = 1;
+	l->next_y = shelf_height;
+	best_shelf = 0;
+
+	found:
+	*layer_out = best_layer;
+	*shelf_out = best_shelf;
+	return 1;
 }
 
-static void gpudl__request_device_callback(WGPURequestDeviceStatus status, WGPUDevice received, const char *message, void *userdata) {
-	*(WGPUDevice *)userdata = received;
+int gpudl_atlas_add(int atlas, uint64_t key, int width, int height, const uint32_t* pixels, struct gpudl_atlas_rect* rect)
+{
+	struct gpudl__atlas* a = gpudl__get_atlas(atlas);
+	assert((width > 0 && height > 0) && "invalid image size");
+	// a 1 pixel gutter of repeated edge pixels keeps linear filtering
+	// from bleeding in neighbours
+	const int w = width + 2;
+	const int h = height + 2;
+	if (w > a->size || h > a->size) return 0;
+
+	gpudl__atlas_key(key);
+	struct gpudl__cache_entry* e = gpudl__object_cache_find(&a->entries);
+	assert((e == NULL) && "key already in atlas");
+
+	int layer, shelf;
+	if (!gpudl__atlas_alloc(a, w, h, &layer, &shelf)) return 0;
+	struct gpudl__atlas_shelf* s = &a->layers[layer].shelves[shelf];
+	struct gpudl__atlas_entry* entry = malloc(sizeof *entry);
+	assert(entry != NULL);
+	*entry = (struct gpudl__atlas_entry){
+		.layer = layer,
+		.shelf = shelf,
+		.x = s->x + 1,
+		.y = s->y + 1,
+		.width = width,
+		.height = height,
+	};
+	s->x += w;
+	s->last_used_frame = gpudl__runtime.frame_counter;
+
+	// (the key scratch may have been used by eviction)
+	gpudl__atlas_key(key);
+	gpudl__object_cache_get(&a->entries)->object = entry;
+
+	uint8_t* padded = malloc((size_t)w * h * 4);
+	assert(padded != NULL);
+	for (int y = 0; y < h; y++) {
+		const int sy = y == 0 ? 0 : y > height ? height-1 : y-1;
+		for (int x = 0; x < w; x++) {
+			const int sx = x == 0 ? 0 : x > width ? width-1 : x-1;
+			// 0xAARRGGBB to the R,G,B,A bytes of RGBA8Unorm
+			const uint32_t argb = pixels[sy*width + sx];
+			uint8_t* dst = &padded[(y*w + x) * 4];
+			dst[0] = argb >> 16;
+			dst[1] = argb >> 8;
+			dst[2] = argb;
+			dst[3] = argb >> 24;
+		}
+	}
+	// only the new rectangle is written
+	wgpuQueueWriteTexture(
+		gpudl__runtime.wgpu_queue,
+		&(WGPUImageCopyTexture){
+			.texture = a->texture,
+			.origin = (WGPUOrigin3D){ .x = entry->x - 1, .y = entry->y - 1, .z = layer },
+			.aspect = WGPUTextureAspect_All,
+		},
+		padded, (size_t)w * h * 4,
+		&(WGPUTextureDataLayout){ .bytesPerRow = w * 4, .rowsPerImage = h },
+		&(WGPUExtent3D){ .width = w, .height = h, .depthOrArrayLayers = 1 });
+	free(padded);
+	a->stats.n_uploads++;
+	a->stats.upload_bytes += (uint64_t)w * h * 4;
+
+	gpudl__atlas_fill_rect(a, entry, rect);
+	return 1;
 }
 
-static void gpudl__wgpu_error_callback(WGPUErrorType type, char const* message, void* userdata)
+static int gpudl__texture_format_size(WGPUTextureFormat format)
 {
-	const char* ts = NULL;
-	switch (type) {
-	case WGPUErrorType_NoError: ts = "(noerror)"; break;
-	case WGPUErrorType_Validation: ts = "(validation)"; break;
-	case WGPUErrorType_OutOfMemory: ts = "(outofmemory)"; break;
-	case WGPUErrorType_Unknown: ts = "(unknown)"; break;
-	case WGPUErrorType_DeviceLost: ts = "(devicelost)"; break;
-	default: ts = "(unhandled)"; break;
+	switch (format) {
+	case WGPUTextureFormat_R8Unorm:
+		return 1;
+	case WGPUTextureFormat_RG8Unorm:
+	case WGPUTextureFormat_R16Float:
+		return 2;
+	case WGPUTextureFormat_RGBA16Float:
+	case WGPUTextureFormat_RG32Float:
+		return 8;
+	case WGPUTextureFormat_RGBA32Float:
+		return 16;
+	default:
+		return 4;
 	}
-	assert(ts);
-	fprintf(stderr, "WGPU UNCAPTURED ERROR %s: %s\n", ts, message);
 }
 
-static void gpudl__wgpu_post_init(struct gpudl__window* win)
+static uint64_t gpudl__graph_texture_bytes(const struct gpudl_graph_texture_desc* desc)
 {
-	if (gpudl__runtime.wgpu_adapter) return;
+	return (uint64_t)desc->width * desc->height * gpudl__texture_format_size(desc->format);
+}
 
-	wgpuInstanceRequestAdapter(
-		gpudl__runtime.wgpu_instance,
-		&(WGPURequestAdapterOptions){
-			.compatibleSurface = win->wgpu_surface,
-			.nextInChain = (const WGPUChainedStruct*) &(struct gpudl__WGPUAdapterExtras) {
-				.chain = (WGPUChainedStruct) {
-					.next = NULL,
-					.sType = gpudl__WGPUSType_AdapterExtras,
-				},
-				.backend = WGPUBackendType_Vulkan,
-				//.backend = WGPUBackendType_OpenGL, // XXX not supported
-				//.backend = WGPUBackendType_OpenGLES, // XXX not supported
-			},
-		},
-		gpudl__request_adapter_callback,
-		&gpudl__runtime.wgpu_adapter);
-	assert((gpudl__runtime.wgpu_adapter != NULL) && "got no adapter; expected wgpuInstanceRequestAdapter() to not actually be async");
+void gpudl_graph_begin(WGPUTextureView backbuffer, int width, int height)
+{
+	struct gpudl__graph* g = &gpudl__runtime.graph;
+	assert(!g->building && "gpudl_graph_begin() called twice");
+	g->building = 1;
+	g->width = width;
+	g->height = height;
+	g->n_resources = 0;
+	g->n_passes = 0;
+	g->n_accesses = 0;
+	const int backbuffer_id = gpudl_graph_import_texture(backbuffer);
+	assert(backbuffer_id == GPUDL_GRAPH_BACKBUFFER);
+}
 
-	WGPURequiredLimits* required_limits = &(WGPURequiredLimits){
-		.nextInChain = NULL,
+static struct gpudl__graph_resource* gpudl__graph_add_resource(void)
+{
+	struct gpudl__graph* g = &gpudl__runtime.graph;
+	assert(g->building && "not between gpudl_graph_begin() and gpudl_graph_execute()");
+	g->resources = gpudl__grow(g->resources, &g->cap_resources, g->n_resources + 1, sizeof g->resources[0]);
+	struct gpudl__graph_resource* r = &g->resources[g->n_resources++];
+	memset(r, 0, sizeof *r);
+	r->physical = -1;
+	r->first_pass = -1;
+	r->last_pass = -1;
+	return r;
+}
+
+int gpudl_graph_create_texture(const struct gpudl_graph_texture_desc* desc)
+{
+	struct gpudl__graph* g = &gpudl__runtime.graph;
+	struct gpudl__graph_resource* r = gpudl__graph_add_resource();
+	r->desc = *desc;
+	if (r->desc.width == 0) r->desc.width = g->width;
+	if (r->desc.height == 0) r->desc.height = g->height;
+	r->desc.usage |= WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_TextureBinding;
+	return g->n_resources;
+}
+
+int gpudl_graph_import_texture(WGPUTextureView view)
+{
+	struct gpudl__graph_resource* r = gpudl__graph_add_resource();
+	r->imported = 1;
+	r->view = view;
+	return gpudl__runtime.graph.n_resources;
+}
+
+int gpudl_graph_add_pass(const char* name, gpudl_graph_pass_func fn, void* userdata)
+{
+	struct gpudl__graph* g = &gpudl__runtime.graph;
+	assert(g->building && "not between gpudl_graph_begin() and gpudl_graph_execute()");
+	g->passes = gpudl__grow(g->passes, &g->cap_passes, g->n_passes + 1, sizeof g->passes[0]);
+	g->passes[g->n_passes++] = (struct gpudl__graph_pass){
+		.name = name,
+		.fn = fn,
+		.userdata = userdata,
+		.first_access = g->n_accesses,
 	};
-	memcpy(&required_limits->limits, &gpudl__runtime.limits, sizeof required_limits->limits);
+	return g->n_passes;
+}
 
-	wgpuAdapterRequestDevice(
-		gpudl__runtime.wgpu_adapter,
-		&(WGPUDeviceDescriptor){
-			// XXX isn't this useless?
-			.nextInChain = (const WGPUChainedStruct *)&(struct gpudl__WGPUDeviceExtras){
-				.chain = (WGPUChainedStruct){
-					.next = NULL,
-					.sType = gpudl__WGPUSType_DeviceExtras,
-				},
-				.label = "Device",
-				.tracePath = NULL,
-			},
-			.requiredLimits = required_limits,
-		},
-		gpudl__request_device_callback,
-		&gpudl__runtime.wgpu_device);
-	assert((gpudl__runtime.wgpu_device != NULL) && "got no device; expected wgpuAdapterRequestDevice() to not actually be async");
+static void gpudl__graph_access(int pass, int resource, int write)
+{
+	struct gpudl__graph* g = &gpudl__runtime.graph;
+	assert((pass == g->n_passes) && "declare reads/writes right after gpudl_graph_add_pass()");
+	assert((1 <= resource && resource <= g->n_resources) && "invalid graph resource");
+	g->accesses = gpudl__grow(g->accesses, &g->cap_accesses, g->n_accesses + 1, sizeof g->accesses[0]);
+	g->accesses[g->n_accesses++] = (struct gpudl__graph_access){ .resource = resource-1, .write = write };
+	g->passes[pass-1].n_accesses++;
+	// writing to something from outside the graph is observable
+	if (write && g->resources[resource-1].imported) g->passes[pass-1].side_effect = 1;
+}
 
+void gpudl_graph_read(int pass, int resource)
+{
+	gpudl__graph_access(pass, resource, 0);
+}
 
-	gpudl__runtime.wgpu_queue = wgpuDeviceGetQueue(gpudl__runtime.wgpu_device);
-	assert(gpudl__runtime.wgpu_queue);
+void gpudl_graph_write(int pass, int resource)
+{
+	gpudl__graph_access(pass, resource, 1);
+}
 
-	gpudl__runtime.wgpu_swap_chain_format = wgpuSurfaceGetPreferredFormat(win->wgpu_surface, gpudl__runtime.wgpu_adapter);
+void gpudl_graph_set_side_effect(int pass)
+{
+	assert((1 <= pass && pass <= gpudl__runtime.graph.n_passes) && "invalid graph pass");
+	gpudl__runtime.graph.passes[pass-1].side_effect = 1;
+}
 
-	wgpuDeviceSetUncapturedErrorCallback(gpudl__runtime.wgpu_device, gpudl__wgpu_error_callback, NULL);
+static struct gpudl__graph_resource* gpudl__graph_get_resource(int resource)
+{
+	struct gpudl__graph* g = &gpudl__runtime.graph;
+	assert((1 <= resource && resource <= g->n_resources) && "invalid graph resource");
+	return &g->resources[resource-1];
 }
 
-int gpudl_window_open(const char* title)
+WGPUTextureView gpudl_graph_get_view(int resource)
 {
-	assert((gpudl__runtime.n_windows < GPUDL__MAX_WINDOWS) && "too many windowz!");
-	struct gpudl__window* win = &gpudl__runtime.windows[gpudl__runtime.n_windows++];
+	struct gpudl__graph_resource* r = gpudl__graph_get_resource(resource);
+	assert((r->view != NULL) && "graph texture has no memory outside the passes using it");
+	return r->view;
+}
 
-	win->id = gpudl__get_next_serial();
+WGPUTexture gpudl_graph_get_texture(int resource)
+{
+	struct gpudl__graph_resource* r = gpudl__graph_get_resource(resource);
+	assert(!r->imported && "imported graph textures only have a view");
+	assert((r->view != NULL) && "graph texture has no memory outside the passes using it");
+	return gpudl__runtime.graph.physical[r->physical].texture;
+}
 
-	win->x11_window = XCreateWindow(
-		gpudl__runtime.x11_display,
-		gpudl__runtime.x11_root_window,
-		0, 0,
-		256, 256, // XXX default dimensions?
-		0, // border width
-		gpudl__runtime.x11_depth,
-		InputOutput,
-		gpudl__runtime.x11_visual,
-		CWBorderPixel | CWColormap | CWEventMask,
-		&(XSetWindowAttributes) {
-			.background_pixmap = None,
-			.colormap = gpudl__runtime.x11_colormap,
-			.border_pixel = 0,
-			.event_mask =
-				  StructureNotifyMask
-				| EnterWindowMask
-				| LeaveWindowMask
-				| ButtonPressMask
-				| ButtonReleaseMask
-				| PointerMotionMask
-				| KeyPressMask
-				| KeyReleaseMask
-				| ExposureMask
-				| FocusChangeMask
-				| PropertyChangeMask
-				| VisibilityChangeMask
+static void gpudl__graph_release_physical(struct gpudl__graph_physical* p)
+{
+	gpudl_forget_bind_groups_using(p->view);
+	wgpuTextureViewDrop(p->view);
+	wgpuTextureDestroy(p->texture);
+	wgpuTextureDrop(p->texture);
+}
+
+// finds a free pooled texture matching the resource's description, or
+// creates one
+static int gpudl__graph_acquire(struct gpudl__graph_resource* r)
+{
+	struct gpudl__graph* g = &gpudl__runtime.graph;
+	for (int i = 0; i < g->n_physical; i++) {
+		struct gpudl__graph_physical* p = &g->physical[i];
+		if (p->in_use || memcmp(&p->desc, &r->desc, sizeof p->desc) != 0) continue;
+		p->in_use = 1;
+		p->last_used_frame = gpudl__runtime.frame_counter;
+		return i;
+	}
+	g->physical = gpudl__grow(g->physical, &g->cap_physical, g->n_physical + 1, sizeof g->physical[0]);
+	struct gpudl__graph_physical* p = &g->physical[g->n_physical];
+	p->desc = r->desc;
+	p->in_use = 1;
+	p->last_used_frame = gpudl__runtime.frame_counter;
+	p->texture = wgpuDeviceCreateTexture(gpudl__runtime.wgpu_device, &(WGPUTextureDescriptor){
+		.label = "gpudl graph texture",
+		.usage = r->desc.usage,
+		.dimension = WGPUTextureDimension_2D,
+		.size = (WGPUExtent3D){ .width = r->desc.width, .height = r->desc.height, .depthOrArrayLayers = 1 },
+		.format = r->desc.format,
+		.mipLevelCount = 1,
+		.sampleCount = 1,
+	});
+	assert(p->texture != NULL);
+	p->view = wgpuTextureCreateView(p->texture, &(WGPUTextureViewDescriptor){
+		.format = r->desc.format,
+		.dimension = WGPUTextureViewDimension_2D,
+		.mipLevelCount = 1,
+		.arrayLayerCount = 1,
+		.aspect = WGPUTextureAspect_All,
+	});
+	g->stats.n_texture_creations++;
+	return g->n_physical++;
+}
+
+void gpudl_graph_execute(void)
+{
+	struct gpudl__graph* g = &gpudl__runtime.graph;
+	assert(g->building && "gpudl_graph_execute() without gpudl_graph_begin()");
+	g->building = 0;
+
+	// culling: walking backwards, a pass is live if it has side effects,
+	// or if a live pass after it reads something it writes
+	for (int i = 0; i < g->n_resources; i++) g->resources[i].needed = 0;
+	g->stats.n_passes = g->n_passes;
+	g->stats.n_culled = 0;
+	for (int i = g->n_passes-1; i >= 0; i--) {
+		struct gpudl__graph_pass* pass = &g->passes[i];
+		const struct gpudl__graph_access* accesses = &g->accesses[pass->first_access];
+		pass->live = pass->side_effect;
+		for (int j = 0; j < pass->n_accesses && !pass->live; j++) {
+			if (accesses[j].write && g->resources[accesses[j].resource].needed) pass->live = 1;
 		}
-	);
-	assert(win->x11_window && "XCreateWindow() failed");
+		if (!pass->live) {
+			g->stats.n_culled++;
+			continue;
+		}
+		// (a pass that reads what it writes needs an earlier writer)
+		for (int j = 0; j < pass->n_accesses; j++) {
+			if (accesses[j].write) g->resources[accesses[j].resource].needed = 0;
+		}
+		for (int j = 0; j < pass->n_accesses; j++) {
+			if (!accesses[j].write) g->resources[accesses[j].resource].needed = 1;
+		}
+	}
 
-	win->x11_ic = XCreateIC(
-		gpudl__runtime.x11_im,
-		XNInputStyle,      XIMPreeditNothing | XIMStatusNothing,
-		XNClientWindow,    win->x11_window,
-		XNFocusWindow,     win->x11_window,
-		NULL);
-	assert(win->x11_ic != NULL);
+	// lifetimes of transient textures, in live passes
+	g->stats.n_transient = 0;
+	g->stats.unaliased_bytes = 0;
+	for (int i = 0; i < g->n_passes; i++) {
+		struct gpudl__graph_pass* pass = &g->passes[i];
+		if (!pass->live) continue;
+		for (int j = 0; j < pass->n_accesses; j++) {
+			struct gpudl__graph_resource* r = &g->resources[g->accesses[pass->first_access + j].resource];
+			if (r->imported) continue;
+			if (r->first_pass < 0) {
+				r->first_pass = i;
+				g->stats.n_transient++;
+				g->stats.unaliased_bytes += gpudl__graph_texture_bytes(&r->desc);
+			}
+			r->last_pass = i;
+		}
+	}
 
-	XStoreName(gpudl__runtime.x11_display, win->x11_window, title);
-	XMapWindow(gpudl__runtime.x11_display, win->x11_window);
+	// everything goes into one encoder. transient textures get memory
+	// from the pool right before their first pass, and give it back after
+	// their last, so textures with disjoint lifetimes share it. the passes
+	// run in order on the GPU, so sharing needs no extra synchronization
+	WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(gpudl__runtime.wgpu_device, &(WGPUCommandEncoderDescriptor){ .label = "gpudl graph" });
+	for (int i = 0; i < g->n_passes; i++) {
+		struct gpudl__graph_pass* pass = &g->passes[i];
+		if (!pass->live) continue;
+		const struct gpudl__graph_access* accesses = &g->accesses[pass->first_access];
+		for (int j = 0; j < pass->n_accesses; j++) {
+			struct gpudl__graph_resource* r = &g->resources[accesses[j].resource];
+			if (r->first_pass != i || r->physical >= 0) continue;
+			r->physical = gpudl__graph_acquire(r);
+			r->view = g->physical[r->physical].view;
+		}
+		if (pass->name) gpudl_gpu_scope_begin(encoder, pass->name);
+		pass->fn(encoder, pass->userdata);
+		if (pass->name) gpudl_gpu_scope_end(encoder, pass->name);
+		for (int j = 0; j < pass->n_accesses; j++) {
+			struct gpudl__graph_resource* r = &g->resources[accesses[j].resource];
+			if (r->last_pass != i || r->physical < 0 || r->view == NULL) continue;
+			g->physical[r->physical].in_use = 0;
+			r->view = NULL;
+		}
+	}
+	WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(encoder, &(WGPUCommandBufferDescriptor){0});
+	gpudl_upload_uniforms();
+	wgpuQueueSubmit(gpudl__runtime.wgpu_queue, 1, &cmd);
+
+	// trim the pool of textures no recent frame needed
+	g->stats.pool_bytes = 0;
+	for (int i = 0; i < g->n_physical;) {
+		struct gpudl__graph_physical* p = &g->physical[i];
+		if ((gpudl__runtime.frame_counter - p->last_used_frame) > GPUDL_GRAPH_TEXTURE_MAX_AGE) {
+			gpudl__graph_release_physical(p);
+			*p = g->physical[--g->n_physical];
+			continue;
+		}
+		g->stats.pool_bytes += gpudl__graph_texture_bytes(&p->desc);
+		i++;
+	}
+	g->stats.n_pooled = g->n_physical;
+}
 
-	gpudl__runtime.x11_WM_DELETE_WINDOW = XInternAtom(gpudl__runtime.x11_display, "WM_DELETE_WINDOW", False);
-	XSetWMProtocols(gpudl__runtime.x11_display, win->x11_window, &gpudl__runtime.x11_WM_DELETE_WINDOW, 1);
+void gpudl_graph_get_stats(struct gpudl_graph_stats* stats)
+{
+	*stats = gpudl__runtime.graph.stats;
+}
 
-	win->wgpu_surface = wgpuInstanceCreateSurface(
-		gpudl__runtime.wgpu_instance,
-		&(WGPUSurfaceDescriptor){
-			.label = NULL,
-			.nextInChain = (const WGPUChainedStruct *)&(WGPUSurfaceDescriptorFromXlibWindow){
-				.chain = (WGPUChainedStruct){
-					.next = NULL,
-					.sType = WGPUSType_SurfaceDescriptorFromXlibWindow,
-				},
-				.display = gpudl__runtime.x11_display,
-				.window = win->x11_window,
-			},
+static void gpudl__graph_shutdown(void)
+{
+	struct gpudl__graph* g = &gpudl__runtime.graph;
+	for (int i = 0; i < g->n_physical; i++) gpudl__graph_release_physical(&g->physical[i]);
+	free(g->physical);
+	free(g->resources);
+	free(g->passes);
+	free(g->accesses);
+	memset(g, 0, sizeof *g);
+}
+
+static void gpudl__profiler_map_callback(WGPUBufferMapAsyncStatus status, void* userdata)
+{
+	struct gpudl__profiler_frame* f = userdata;
+	f->state = status == WGPUBufferMapAsyncStatus_Success ? GPUDL__PROFILER_MAPPED : GPUDL__PROFILER_FAILED;
+}
+
+static void gpudl__profiler_publish(struct gpudl__profiler_frame* f)
+{
+	memcpy(gpudl__runtime.profiler_latest, f->scopes, f->n_scopes * sizeof f->scopes[0]);
+	gpudl__runtime.profiler_latest_n = f->n_scopes;
+	gpudl__runtime.profiler_latest_frame = f->frame;
+	gpudl__runtime.profiler_latest_valid = 1;
+}
+
+// picks up resolved timestamps without waiting for the GPU
+static void gpudl__profiler_collect(void)
+{
+	int any_mapping = 0;
+	for (int i = 0; i < GPUDL__PROFILER_FRAMES; i++) {
+		if (gpudl__runtime.profiler_frames[i].state == GPUDL__PROFILER_MAPPING) any_mapping = 1;
+	}
+	if (any_mapping) wgpuDevicePoll(gpudl__runtime.wgpu_device, false);
+	// oldest first, so the latest profile ends up the newest
+	for (;;) {
+		struct gpudl__profiler_frame* oldest = NULL;
+		for (int i = 0; i < GPUDL__PROFILER_FRAMES; i++) {
+			struct gpudl__profiler_frame* f = &gpudl__runtime.profiler_frames[i];
+			if (f->state != GPUDL__PROFILER_MAPPED && f->state != GPUDL__PROFILER_FAILED) continue;
+			if (oldest == NULL || f->frame < oldest->frame) oldest = f;
 		}
-	);
-	assert(win->wgpu_surface);
+		if (oldest == NULL) break;
+		if (oldest->state == GPUDL__PROFILER_MAPPED) {
+			const size_t size = oldest->n_scopes * 2 * sizeof(uint64_t);
+			const uint64_t* ticks = wgpuBufferGetMappedRange(oldest->readback_buffer, 0, size);
+			// XXX wgpu-native doesn't expose the queue's timestamp
+			// period; see gpudl_set_gpu_timestamp_period()
+			const float ns_per_tick = gpudl__runtime.profiler_ns_per_tick > 0 ? gpudl__runtime.profiler_ns_per_tick : 1.0f;
+			const double ms_per_tick = ns_per_tick * 1e-6;
+			for (int i = 0; i < oldest->n_scopes; i++) {
+				const uint64_t t0 = ticks[i*2], t1 = ticks[i*2+1];
+				oldest->scopes[i].gpu_ms = t1 > t0 ? (t1 - t0) * ms_per_tick : 0;
+			}
+			wgpuBufferUnmap(oldest->readback_buffer);
+			gpudl__profiler_publish(oldest);
+		}
+		oldest->state = GPUDL__PROFILER_FREE;
+	}
+}
 
-	gpudl__wgpu_post_init(win);
+static void gpudl__profiler_create_queries(struct gpudl__profiler_frame* f)
+{
+	WGPUDevice device = gpudl__runtime.wgpu_device;
+	const size_t size = GPUDL_GPU_PROFILER_MAX_SCOPES * 2 * sizeof(uint64_t);
+	f->query_set = wgpuDeviceCreateQuerySet(device, &(WGPUQuerySetDescriptor){
+		.label = "gpudl profiler",
+		.type = WGPUQueryType_Timestamp,
+		.count = GPUDL_GPU_PROFILER_MAX_SCOPES * 2,
+	});
+	assert(f->query_set != NULL);
+	f->resolve_buffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+		.label = "gpudl profiler resolve",
+		.usage = WGPUBufferUsage_QueryResolve | WGPUBufferUsage_CopySrc,
+		.size = size,
+	});
+	f->readback_buffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+		.label = "gpudl profiler readback",
+		.usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst,
+		.size = size,
+	});
+	assert(f->resolve_buffer != NULL && f->readback_buffer != NULL);
+}
 
-	return win->id;
+void gpudl_gpu_scope_begin(WGPUCommandEncoder encoder, const char* name)
+{
+	assert((gpudl__runtime.profiler_depth < GPUDL__PROFILER_MAX_DEPTH) && "gpu scopes nested too deep");
+	int* top = &gpudl__runtime.profiler_stack[gpudl__runtime.profiler_depth++];
+	*top = -1;
+
+	struct gpudl__profiler_frame* f = gpudl__runtime.profiler_current;
+	if (f == NULL) {
+		for (int i = 0; i < GPUDL__PROFILER_FRAMES && f == NULL; i++) {
+			if (gpudl__runtime.profiler_frames[i].state == GPUDL__PROFILER_FREE) f = &gpudl__runtime.profiler_frames[i];
+		}
+		// all frames still in flight (or waiting to be collected): this
+		// frame goes unprofiled
+		if (f == NULL) return;
+		f->state = GPUDL__PROFILER_RECORDING;
+		f->frame = gpudl__runtime.frame_counter;
+		f->n_scopes = 0;
+		gpudl__runtime.profiler_current = f;
+	}
+	if (f->n_scopes == GPUDL_GPU_PROFILER_MAX_SCOPES) return;
+
+	const int index = f->n_scopes++;
+	const int parent = gpudl__runtime.profiler_depth >= 2 ? top[-1] : -1;
+	f->scopes[index] = (struct gpudl_gpu_scope){
+		.name = name,
+		.parent = parent,
+		.depth = parent >= 0 ? f->scopes[parent].depth + 1 : 0,
+		.gpu_ms = -1,
+	};
+	f->cpu_begin_us[index] = gpudl_time_us();
+	if (gpudl__runtime.has_timestamp_query) {
+		if (f->query_set == NULL) gpudl__profiler_create_queries(f);
+		wgpuCommandEncoderWriteTimestamp(encoder, f->query_set, index*2);
+	}
+	*top = index;
 }
 
-WGPUSurface gpudl_window_get_surface(int window_id)
+void gpudl_gpu_scope_end(WGPUCommandEncoder encoder, const char* name)
 {
-	struct gpudl__window* win = gpudl__get_window(window_id);
-	return win->wgpu_surface;
+	assert((gpudl__runtime.profiler_depth > 0) && "gpudl_gpu_scope_end() without gpudl_gpu_scope_begin()");
+	const int index = gpudl__runtime.profiler_stack[--gpudl__runtime.profiler_depth];
+	if (index < 0) return;
+	struct gpudl__profiler_frame* f = gpudl__runtime.profiler_current;
+	struct gpudl_gpu_scope* scope = &f->scopes[index];
+	assert((strcmp(scope->name, name) == 0) && "gpu scopes ended out of order");
+	scope->cpu_ms = (gpudl_time_us() - f->cpu_begin_us[index]) * 1e-3;
+	if (gpudl__runtime.has_timestamp_query) {
+		wgpuCommandEncoderWriteTimestamp(encoder, f->query_set, index*2 + 1);
+	}
 }
 
-void gpudl_window_get_size(int window_id, int* width, int* height)
+// called by gpudl_render_end(), after everything in the frame has been
+// submitted
+static void gpudl__profiler_end_frame(void)
 {
-	struct gpudl__window* win = gpudl__get_window(window_id);
-	if (width)  *width  = win->width;
-	if (height) *height = win->height;
+	assert((gpudl__runtime.profiler_depth == 0) && "gpu scope still open at the end of the frame");
+	struct gpudl__profiler_frame* f = gpudl__runtime.profiler_current;
+	gpudl__runtime.profiler_current = NULL;
+	if (f != NULL && !gpudl__runtime.has_timestamp_query) {
+		gpudl__profiler_publish(f);
+		f->state = GPUDL__PROFILER_FREE;
+	} else if (f != NULL) {
+		const uint32_t n_queries = f->n_scopes * 2;
+		const size_t size = n_queries * sizeof(uint64_t);
+		WGPUCommandEncoder encoder = wgpuDeviceCreateCommandEncoder(gpudl__runtime.wgpu_device, &(WGPUCommandEncoderDescriptor){ .label = "gpudl profiler" });
+		wgpuCommandEncoderResolveQuerySet(encoder, f->query_set, 0, n_queries, f->resolve_buffer, 0);
+		wgpuCommandEncoderCopyBufferToBuffer(encoder, f->resolve_buffer, 0, f->readback_buffer, 0, size);
+		WGPUCommandBuffer cmd = wgpuCommandEncoderFinish(encoder, &(WGPUCommandBufferDescriptor){0});
+		wgpuQueueSubmit(gpudl__runtime.wgpu_queue, 1, &cmd);
+		f->state = GPUDL__PROFILER_MAPPING;
+		wgpuBufferMapAsync(f->readback_buffer, WGPUMapMode_Read, 0, size, gpudl__profiler_map_callback, f);
+	}
+	gpudl__profiler_collect();
 }
 
-void gpudl_window_close(int window_id)
+int gpudl_get_gpu_profile(struct gpudl_gpu_profile* profile)
 {
-	int index = gpudl__get_window_index(window_id);
-	struct gpudl__window* win = &gpudl__runtime.windows[index];
-	XDestroyWindow(gpudl__runtime.x11_display, win->x11_window);
-	int n_move = (gpudl__runtime.n_windows - index) - 1;
-	if (n_move > 0) {
-		memmove(
-			&gpudl__runtime.windows[index],
-			&gpudl__runtime.windows[index+1],
-			n_move * sizeof(gpudl__runtime.windows[0])
-		);
+	if (gpudl__runtime.wgpu_device != NULL) gpudl__profiler_collect();
+	if (!gpudl__runtime.profiler_latest_valid) return 0;
+	profile->frame = gpudl__runtime.profiler_latest_frame;
+	profile->has_gpu_times = gpudl__runtime.has_timestamp_query;
+	profile->n_scopes = gpudl__runtime.profiler_latest_n;
+	profile->scopes = gpudl__runtime.profiler_latest;
+	return 1;
+}
+
+int gpudl_gpu_profiler_has_timestamps(void)
+{
+	return gpudl__runtime.has_timestamp_query;
+}
+
+void gpudl_set_gpu_timestamp_period(float ns_per_tick)
+{
+	gpudl__runtime.profiler_ns_per_tick = ns_per_tick;
+}
+
+static void gpudl__profiler_shutdown(void)
+{
+	for (int i = 0; i < GPUDL__PROFILER_FRAMES; i++) {
+		if (gpudl__runtime.profiler_frames[i].state == GPUDL__PROFILER_MAPPING) {
+			wgpuDevicePoll(gpudl__runtime.wgpu_device, true);
+			break;
+		}
 	}
-	gpudl__runtime.n_windows--;
+	for (int i = 0; i < GPUDL__PROFILER_FRAMES; i++) {
+		struct gpudl__profiler_frame* f = &gpudl__runtime.profiler_frames[i];
+		if (f->query_set == NULL) continue;
+		if (f->state == GPUDL__PROFILER_MAPPED) wgpuBufferUnmap(f->readback_buffer);
+		wgpuQuerySetDestroy(f->query_set);
+		wgpuBufferDestroy(f->resolve_buffer);
+		wgpuBufferDestroy(f->readback_buffer);
+	}
+}
+
+void gpudl_shutdown(void)
+{
+	if (!gpudl__runtime.is_initialized) return;
+
+	#ifndef GPUDL_WAYLAND
+	gpudl_set_window_pool(0, 0, 0);
+	#endif
+	while (gpudl__runtime.n_windows > 0) {
+		gpudl_window_close(gpudl__runtime.windows[gpudl__runtime.n_windows-1].id);
+	}
+
+	for (int i = 0; i < GPUDL_MAX_CURSORS; i++) {
+		struct gpudl__cursor* cursor = &gpudl__runtime.cursors[i];
+		if (!cursor->in_use) continue;
+		#ifdef GPUDL_WAYLAND
+		// (system cursor buffers belong to the cursor theme)
+		if (i >= GPUDL_CURSOR_END && cursor->wl_buffer) wl_buffer_destroy(cursor->wl_buffer);
+		#else
+		XFreeCursor(gpudl__runtime.x11_display, cursor->cursor);
+		#endif
+		free(cursor->bitmap);
+	}
+
+	// fence callbacks write into gpudl__runtime, which is about to be
+	// cleared
+	if (gpudl_get_n_frames_in_flight() > 0) wgpuDevicePoll(gpudl__runtime.wgpu_device, true);
+
+	gpudl__stream_shutdown();
+	gpudl__2d_shutdown();
+	gpudl__graph_shutdown();
+	gpudl__profiler_shutdown();
+	for (int i = 0; i < GPUDL__MAX_ATLASES; i++) {
+		if (gpudl__runtime.atlases[i].in_use) gpudl__atlas_release(&gpudl__runtime.atlases[i]);
+	}
+	gpudl__uniform_ring_release();
+
+	// (bind groups first; they reference the rest)
+	gpudl__object_cache_clear(&gpudl__runtime.bundle_cache, gpudl__drop_render_bundle);
+	gpudl__object_cache_clear(&gpudl__runtime.bind_group_cache, gpudl__drop_bind_group);
+	gpudl__object_cache_clear(&gpudl__runtime.bind_group_layout_cache, gpudl__drop_bind_group_layout);
+	gpudl__object_cache_clear(&gpudl__runtime.sampler_cache, gpudl__drop_sampler);
+	free(gpudl__runtime.cache_key);
+
+	// NOTE wgpu-native has no way to drop the queue; it goes with the
+	// device
+	if (gpudl__runtime.wgpu_device && wgpuDeviceDrop) wgpuDeviceDrop(gpudl__runtime.wgpu_device);
+	if (gpudl__runtime.wgpu_adapter && wgpuAdapterDrop) wgpuAdapterDrop(gpudl__runtime.wgpu_adapter);
+	if (gpudl__runtime.wgpu_instance && wgpuInstanceDrop) wgpuInstanceDrop(gpudl__runtime.wgpu_instance);
+
+	#ifdef GPUDL_WAYLAND
+	if (gpudl__runtime.wl_cursor_surface) wl_surface_destroy(gpudl__runtime.wl_cursor_surface);
+	if (gpudl__runtime.wl_cursor_theme) wl_cursor_theme_destroy(gpudl__runtime.wl_cursor_theme);
+	if (gpudl__runtime.xkb_state) xkb_state_unref(gpudl__runtime.xkb_state);
+	if (gpudl__runtime.xkb_keymap) xkb_keymap_unref(gpudl__runtime.xkb_keymap);
+	if (gpudl__runtime.xkb_context) xkb_context_unref(gpudl__runtime.xkb_context);
+	if (gpudl__runtime.wl_pointer) gpudl__wl_pointer_release(gpudl__runtime.wl_pointer);
+	if (gpudl__runtime.wl_keyboard) gpudl__wl_keyboard_release(gpudl__runtime.wl_keyboard);
+	if (gpudl__runtime.wl_seat) wl_seat_destroy(gpudl__runtime.wl_seat);
+	for (int i = 0; i < GPUDL__WL_MAX_OUTPUTS; i++) {
+		if (gpudl__runtime.wl_outputs[i].output) wl_output_destroy(gpudl__runtime.wl_outputs[i].output);
+	}
+	if (gpudl__runtime.xdg_wm_base) xdg_wm_base_destroy(gpudl__runtime.xdg_wm_base);
+	if (gpudl__runtime.wl_shm) wl_shm_destroy(gpudl__runtime.wl_shm);
+	if (gpudl__runtime.wl_compositor) wl_compositor_destroy(gpudl__runtime.wl_compositor);
+	wl_registry_destroy(gpudl__runtime.wl_registry);
+	wl_display_disconnect(gpudl__runtime.wl_display);
+	#else
+	if (gpudl__runtime.x11_im) XCloseIM(gpudl__runtime.x11_im);
+	XFreeColormap(gpudl__runtime.x11_display, gpudl__runtime.x11_colormap);
+	XCloseDisplay(gpudl__runtime.x11_display);
+	#endif
+
+	dlclose(gpudl__runtime.dh);
+	#define GPUDL_WGPU_PROC(NAME) wgpu##NAME = NULL;
+	GPUDL_WGPU_PROCS
+	GPUDL_WGPU_OPTIONAL_PROCS
+	#undef GPUDL_WGPU_PROC
+
+	memset(&gpudl__runtime, 0, sizeof gpudl__runtime);
 }
 
 void gpudl_get_wgpu(WGPUInstance* instance, WGPUAdapter* adapter, WGPUDevice* device, WGPUQueue* queue)
@@ -680,48 +5205,151 @@ void gpudl_get_wgpu(WGPUInstance* instance, WGPUAdapter* adapter, WGPUDevice* de
 	}
 }
 
-int gpudl_poll_event(struct gpudl_event* e)
+#ifdef GPUDL_WAYLAND
+static int gpudl__poll_event(struct gpudl_event* e)
+{
+	memset(e, 0, sizeof *e);
+	if (gpudl__runtime.wl_event_head == gpudl__runtime.wl_event_tail) {
+		gpudl__wl_dispatch(0);
+	}
+	while (gpudl__runtime.wl_event_head != gpudl__runtime.wl_event_tail) {
+		struct gpudl_event* qe = &gpudl__runtime.wl_events[gpudl__runtime.wl_event_head];
+		gpudl__runtime.wl_event_head = (gpudl__runtime.wl_event_head + 1) % GPUDL__MAX_QUEUED_EVENTS;
+		if (gpudl__find_window(qe->window_id) == NULL) continue; // closed since
+		memcpy(e, qe, sizeof *e);
+		return 1;
+	}
+	if (gpudl__runtime.wl_repeat_keycode) {
+		const uint64_t now = gpudl_time_us();
+		const uint64_t next = gpudl__runtime.wl_repeat_next_us;
+		if (now >= next) {
+			const uint64_t period = 1000000 / gpudl__runtime.wl_repeat_rate;
+			// don't burst if we weren't polled for a while
+			gpudl__runtime.wl_repeat_next_us = (now - next) < period ? next + period : now + period;
+			memcpy(e, &gpudl__runtime.wl_repeat_event, sizeof *e);
+			e->receive_us = now;
+			if (gpudl__find_window(e->window_id)) return 1;
+			gpudl__runtime.wl_repeat_keycode = 0;
+			memset(e, 0, sizeof *e);
+		}
+	}
+	return gpudl__pop_redraw(e);
+}
+
+static void gpudl__wait_for_events(int timeout_ms)
+{
+	if (gpudl__runtime.wl_repeat_keycode) {
+		// wake up for the next key repeat
+		const uint64_t now = gpudl_time_us();
+		const uint64_t next = gpudl__runtime.wl_repeat_next_us;
+		const int repeat_ms = next > now ? (next - now + 999) / 1000 : 0;
+		if (timeout_ms < 0 || repeat_ms < timeout_ms) timeout_ms = repeat_ms;
+	}
+	gpudl__wl_dispatch(timeout_ms);
+}
+#else
+static struct gpudl__window* gpudl__find_x11_window(Window w)
+{
+	const int n_windows = gpudl__runtime.n_windows;
+	for (int i = 0; i < n_windows; i++) {
+		struct gpudl__window* win = &gpudl__runtime.windows[i];
+		if (win->x11_window == w) return win;
+	}
+	return NULL;
+}
+
+// input methods (with XIMPreeditNothing) only care about key events and
+// their own communication (client messages, properties, selections), so
+// don't bother XFilterEvent() with the high-volume stuff
+static int gpudl__x11_may_filter(int type)
+{
+	switch (type) {
+	case MotionNotify:
+	case ButtonPress:
+	case ButtonRelease:
+	case EnterNotify:
+	case LeaveNotify:
+	case Expose:
+	case ConfigureNotify:
+	case VisibilityNotify:
+	case MapNotify:
+	case UnmapNotify:
+	case GenericEvent:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+static int gpudl__poll_event(struct gpudl_event* e)
 {
 	memset(e, 0, sizeof *e);
 	while (XPending(gpudl__runtime.x11_display)) {
 		XEvent xe;
 		XNextEvent(gpudl__runtime.x11_display, &xe);
-
-		if (XFilterEvent(&xe, None)) continue;
-
-		struct gpudl__window* win = NULL;
-		const int n_windows = gpudl__runtime.n_windows;
-		for (int i = 0; i < n_windows; i++) {
-			struct gpudl__window* maybe_win = &gpudl__runtime.windows[i];
-			if (maybe_win->x11_window == xe.xany.window) {
-				win = maybe_win;
-				break;
+		e->receive_us = gpudl_time_us();
+		e->time = 0;
+
+		if (gpudl__runtime.x11_im && gpudl__x11_may_filter(xe.type) && XFilterEvent(&xe, None)) continue;
+
+		if (xe.type == GenericEvent && gpudl__runtime.x11_present_opcode && xe.xcookie.extension == gpudl__runtime.x11_present_opcode) {
+			// generic events have no xany.window, so they're
+			// handled before the window lookup below
+			if (XGetEventData(gpudl__runtime.x11_display, &xe.xcookie)) {
+				XPresentCompleteNotifyEvent* ce = xe.xcookie.data;
+				if (xe.xcookie.evtype == PresentCompleteNotify && ce->kind == PresentCompleteKindPixmap) {
+					struct gpudl__window* win = gpudl__find_x11_window(ce->window);
+					if (win) {
+						gpudl__window_presented(win, ce->ust, ce->msc);
+						if (win->transparent_until_present == 2) gpudl__x11_window_make_opaque(win);
+						if (ce->mode == PresentCompleteModeFlip) {
+							win->frame_stats.n_flips++;
+						} else if (ce->mode == PresentCompleteModeCopy || ce->mode == PresentCompleteModeSuboptimalCopy) {
+							win->frame_stats.n_copies++;
+						}
+					}
+				}
+				XFreeEventData(gpudl__runtime.x11_display, &xe.xcookie);
 			}
+			continue;
 		}
+
+		struct gpudl__window* win = gpudl__find_x11_window(xe.xany.window);
 		if (win == NULL) continue;
 
 		e->window_id = win->id;
 
 		switch (xe.type) {
+		case KeyPress:
+		case KeyRelease:    e->time = xe.xkey.time;      break;
+		case ButtonPress:
+		case ButtonRelease: e->time = xe.xbutton.time;   break;
+		case MotionNotify:  e->time = xe.xmotion.time;   break;
+		case EnterNotify:
+		case LeaveNotify:   e->time = xe.xcrossing.time; break;
+		default: break;
+		}
+
+		switch (xe.type) {
+		case Expose:
+			win->redraw_pending = 1;
+			break;
 		case ConfigureNotify:
 			if (xe.xconfigure.width != win->width || xe.xconfigure.height != win->height) {
 				printf("EV: configure %d×%d -> %d×%d\n", win->width, win->height, xe.xconfigure.width, xe.xconfigure.height);
+				// window managers often send a burst of these
+				// (e.g. when going fullscreen), so the swap
+				// chain is rebuilt once, when it's needed
 				win->width = xe.xconfigure.width;
 				win->height = xe.xconfigure.height;
-
-				win->wgpu_swap_chain = wgpuDeviceCreateSwapChain(
-					gpudl__runtime.wgpu_device,
-					win->wgpu_surface,
-					&(WGPUSwapChainDescriptor){
-						.usage = WGPUTextureUsage_RenderAttachment,
-						.format = gpudl__runtime.wgpu_swap_chain_format,
-						.width = win->width,
-						.height = win->height,
-						.presentMode = gpudl__runtime.wgpu_present_mode,
-					}
-				);
-				assert(win->wgpu_swap_chain);
-				assert((win->wgpu_surface == (WGPUSurface)win->wgpu_swap_chain) && "wgpu-native assumption: wgpuDeviceCreateSwapChain() should return the passed surface; otherwise this code must free the previous swap chain?");
+				win->swap_chain_stale = 1;
+				win->redraw_pending = 1;
+			}
+			if (win->x11_sync_state == 1) {
+				// the window manager waits for a frame even if
+				// the size didn't change
+				win->x11_sync_state = 2;
+				win->redraw_pending = 1;
 			}
 			break;
 		case EnterNotify:
@@ -730,13 +5358,34 @@ int gpudl_poll_event(struct gpudl_event* e)
 		case LeaveNotify:
 			e->type = GPUDL_LEAVE;
 			return 1;
+		case MapNotify:
+		case UnmapNotify:
+			if (gpudl__window_update_visibility(win, xe.type == MapNotify, win->fully_obscured)) {
+				e->type = GPUDL_VISIBILITY;
+				e->visibility.visible = gpudl__window_is_visible(win);
+				return 1;
+			}
+			break;
+		case VisibilityNotify:
+			if (gpudl__window_update_visibility(win, win->mapped, xe.xvisibility.state == VisibilityFullyObscured)) {
+				e->type = GPUDL_VISIBILITY;
+				e->visibility.visible = gpudl__window_is_visible(win);
+				return 1;
+			}
+			break;
 		case FocusIn:
 			e->type = GPUDL_FOCUS;
+			gpudl__window_update_focus(win, 1);
 			if (xe.xfocus.mode != NotifyGrab && win && win->x11_ic) XSetICFocus(win->x11_ic);
+			if (win && (win->disabled_events & GPUDL_EVENTS_KEYBOARD)) break;
 			return 1;
 		case FocusOut:
 			e->type = GPUDL_UNFOCUS;
+			gpudl__window_update_focus(win, 0);
+			// releases may happen elsewhere
+			memset(gpudl__runtime.x11_keys_down, 0, sizeof gpudl__runtime.x11_keys_down);
 			if (xe.xfocus.mode != NotifyGrab && win && win->x11_ic) XUnsetICFocus(win->x11_ic);
+			if (win && (win->disabled_events & GPUDL_EVENTS_KEYBOARD)) break;
 			return 1;
 		case ButtonPress:
 		case ButtonRelease: {
@@ -760,10 +5409,31 @@ int gpudl_poll_event(struct gpudl_event* e)
 			return 1;
 		case KeyPress:
 		case KeyRelease: {
+			const int keycode = xe.xkey.keycode & 0xff;
+			uint8_t* down_byte = &gpudl__runtime.x11_keys_down[keycode >> 3];
+			const uint8_t down_bit = 1 << (keycode & 7);
+			if (xe.type == KeyRelease) {
+				if (!gpudl__runtime.x11_detectable_autorepeat && XEventsQueued(gpudl__runtime.x11_display, QueuedAfterReading)) {
+					// no detectable auto-repeat; a repeat is then
+					// a release followed by a press with the same
+					// timestamp
+					XEvent next;
+					XPeekEvent(gpudl__runtime.x11_display, &next);
+					if (next.type == KeyPress && next.xkey.window == xe.xkey.window && next.xkey.keycode == xe.xkey.keycode && next.xkey.time == xe.xkey.time) {
+						break;
+					}
+				}
+				*down_byte &= ~down_bit;
+			}
+
 			e->type = GPUDL_KEY;
 			struct gpudl_event_key* ke = &e->key;
 
 			ke->pressed = (xe.type == KeyPress);
+			if (ke->pressed) {
+				ke->repeat = (*down_byte & down_bit) != 0;
+				*down_byte |= down_bit;
+			}
 
 			KeySym sym = XLookupKeysym(&xe.xkey, 0);
 			{
@@ -2150,28 +6820,37 @@ int gpudl_poll_event(struct gpudl_event* e)
 				// function that can only return one event)
 				char buf[8];
 				KeySym fallback_sym;
-				int len = Xutf8LookupString(win->x11_ic, &xe.xkey, buf, sizeof buf, &fallback_sym, NULL);
-				if (len > 0) {
-					const char* p = &buf[0];
-					int codepoint = gpudl_utf8_decode(&p, &len);
-					if (codepoint >= 0) {
-						// define this if you think [ctrl]+[h] should be backspace and not [ctrl]+[h]
-						// you long bearded motherf^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H
-						#ifdef GPUDL_I_HAVE_A_SUFFICIENTLY_LONG_BEARD // TODO upgrade to gpudl_i_have_a_sufficiently_long_beard()?
-						ke->codepoint = codepoint;
-						#else
-						ke->codepoint =
-							((0 <= codepoint && codepoint < ' ') || codepoint == 0x7f)
-							? fallback_sym
-							: codepoint;
-						// NOTE the use of `fallback_sym`; because it comes from Xutf8LookupString()
-						// (and NOT XLookupKeysym()) it's actually slightly closer to being "text input"
-						// because [shift]+[a] gives fallback_sym='A' with Xutf8LookupString(), but
-						// fallback_sym='a' with XLookupKeysym(). So this weird, crappy inconsistency
-						// actually proves useful here, "thanks".
-						#endif
+				int codepoint = -1;
+				if (win->x11_ic) {
+					int len = Xutf8LookupString(win->x11_ic, &xe.xkey, buf, sizeof buf, &fallback_sym, NULL);
+					if (len > 0) {
+						const char* p = &buf[0];
+						codepoint = gpudl_utf8_decode(&p, &len);
+					}
+				} else {
+					// no input method; XLookupString() only
+					// knows latin-1, which maps 1:1 to unicode
+					if (XLookupString(&xe.xkey, buf, sizeof buf, &fallback_sym, NULL) == 1) {
+						codepoint = (unsigned char)buf[0];
 					}
 				}
+				if (codepoint >= 0) {
+					// define this if you think [ctrl]+[h] should be backspace and not [ctrl]+[h]
+					// you long bearded motherf^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H^H
+					#ifdef GPUDL_I_HAVE_A_SUFFICIENTLY_LONG_BEARD // TODO upgrade to gpudl_i_have_a_sufficiently_long_beard()?
+					ke->codepoint = codepoint;
+					#else
+					ke->codepoint =
+						((0 <= codepoint && codepoint < ' ') || codepoint == 0x7f)
+						? fallback_sym
+						: codepoint;
+					// NOTE the use of `fallback_sym`; because it comes from Xutf8LookupString()
+					// (and NOT XLookupKeysym()) it's actually slightly closer to being "text input"
+					// because [shift]+[a] gives fallback_sym='A' with Xutf8LookupString(), but
+					// fallback_sym='a' with XLookupKeysym(). So this weird, crappy inconsistency
+					// actually proves useful here, "thanks".
+					#endif
+				}
 			}
 
 			#if 0
@@ -2184,6 +6863,9 @@ int gpudl_poll_event(struct gpudl_event* e)
 			if (protocol == gpudl__runtime.x11_WM_DELETE_WINDOW) {
 				e->type = GPUDL_CLOSE;
 				return 1;
+			} else if (protocol == gpudl__runtime.x11_NET_WM_SYNC_REQUEST && win->x11_sync_counter) {
+				win->x11_sync_value = (uint64_t)(uint32_t)xe.xclient.data.l[2] | ((uint64_t)(uint32_t)xe.xclient.data.l[3] << 32);
+				win->x11_sync_state = 1;
 			}
 			break;
 		}
@@ -2191,9 +6873,232 @@ int gpudl_poll_event(struct gpudl_event* e)
 		}
 	}
 
+	return gpudl__pop_redraw(e);
+}
+
+static void gpudl__wait_for_events(int timeout_ms)
+{
+	Display* dpy = gpudl__runtime.x11_display;
+	XFlush(dpy);
+	if (XEventsQueued(dpy, QueuedAlready) > 0) return;
+	struct pollfd pfd = {
+		.fd = ConnectionNumber(dpy),
+		.events = POLLIN,
+	};
+	poll(&pfd, 1, timeout_ms);
+}
+#endif
+
+int gpudl_poll_event(struct gpudl_event* e)
+{
+	if (!gpudl__poll_event(e)) return 0;
+	switch (e->type) {
+	case GPUDL_MOTION:
+	case GPUDL_BUTTON:
+	case GPUDL_KEY: {
+		struct gpudl__window* win = gpudl__find_window(e->window_id);
+		if (win == NULL) break;
+		if (win->input_us == 0) win->input_us = gpudl__event_input_us(e);
+		if (e->type == GPUDL_MOTION) {
+			win->has_pointer = 1;
+			win->pointer_x = e->motion.x;
+			win->pointer_y = e->motion.y;
+		}
+		} break;
+	default: break;
+	}
+	return 1;
+}
+
+#ifndef GPUDL_WAYLAND
+struct gpudl__x11_motion_scan {
+	Window window;
+	int found;
+	int x, y;
+};
+
+static Bool gpudl__x11_scan_motion(Display* dpy, XEvent* xe, XPointer arg)
+{
+	struct gpudl__x11_motion_scan* scan = (struct gpudl__x11_motion_scan*)arg;
+	if (xe->type == MotionNotify && xe->xmotion.window == scan->window) {
+		scan->found = 1;
+		scan->x = xe->xmotion.x;
+		scan->y = xe->xmotion.y;
+	}
+	return False; // never remove events from the queue
+}
+#endif
+
+int gpudl_get_latest_pointer(int window_id, float* x, float* y)
+{
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	#ifdef GPUDL_WAYLAND
+	// the pointer listener keeps track of the position as events are
+	// dispatched, independent of the event queue
+	gpudl__wl_dispatch(0);
+	if (gpudl__runtime.wl_pointer_window_id == window_id) {
+		win->has_pointer = 1;
+		win->pointer_x = gpudl__runtime.wl_pointer_x;
+		win->pointer_y = gpudl__runtime.wl_pointer_y;
+	}
+	#else
+	// XCheckIfEvent() reads whatever the server has sent so far and
+	// offers every queued event to the predicate, which picks out the
+	// newest motion without consuming anything
+	struct gpudl__x11_motion_scan scan = { .window = win->x11_window };
+	XEvent xe;
+	XCheckIfEvent(gpudl__runtime.x11_display, &xe, gpudl__x11_scan_motion, (XPointer)&scan);
+	if (scan.found) {
+		win->has_pointer = 1;
+		win->pointer_x = scan.x;
+		win->pointer_y = scan.y;
+	}
+	#endif
+	if (!win->has_pointer) return 0;
+	if (x) *x = win->pointer_x;
+	if (y) *y = win->pointer_y;
+	return 1;
+}
+
+int gpudl_wait_event(struct gpudl_event* e, int timeout_ms)
+{
+	const uint64_t t0 = gpudl_time_us();
+	for (;;) {
+		if (gpudl_poll_event(e)) return 1;
+		int remaining_ms = -1;
+		if (timeout_ms >= 0) {
+			const int elapsed_ms = (gpudl_time_us() - t0) / 1000;
+			if (elapsed_ms >= timeout_ms) return 0;
+			remaining_ms = timeout_ms - elapsed_ms;
+		}
+		// may wake up for events that don't become gpudl events
+		// (filtered by the input method, present notifications, ...)
+		// hence the loop
+		gpudl__wait_for_events(remaining_ms);
+	}
+}
+
+void gpudl_window_invalidate(int window_id)
+{
+	gpudl__get_window(window_id)->redraw_pending = 1;
+}
+
+static void gpudl__sleep_until(uint64_t t)
+{
+	if (t > GPUDL_FRAME_LIMITER_SPIN_US && gpudl_time_us() < (t - GPUDL_FRAME_LIMITER_SPIN_US)) {
+		const uint64_t wake = t - GPUDL_FRAME_LIMITER_SPIN_US;
+		const struct timespec ts = {
+			.tv_sec = wake / 1000000,
+			.tv_nsec = (wake % 1000000) * 1000,
+		};
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+	}
+	while (gpudl_time_us() < t) {}
+}
+
+// is a window other than `win` due for rendering before time t?
+static int gpudl__other_window_due_before(struct gpudl__window* win, uint64_t t)
+{
+	const int n_windows = gpudl__runtime.n_windows;
+	for (int i = 0; i < n_windows; i++) {
+		struct gpudl__window* other = &gpudl__runtime.windows[i];
+		if (other == win || !other->wgpu_swap_chain) continue;
+		const int fps = gpudl__window_get_fps_limit(other);
+		if (fps < 0) continue;
+		if (fps == 0 || other->frame_deadline_us < t) return 1;
+	}
 	return 0;
 }
 
+static void gpudl__window_frame_begun(struct gpudl__window* win, int fps)
+{
+	const uint64_t now = gpudl_time_us();
+	struct gpudl_frame_stats* st = &win->frame_stats;
+
+	if (win->frame_begin_us > 0) {
+		const uint64_t interval = now - win->frame_begin_us;
+		if (st->n_frames == 0 || interval < st->interval_min) st->interval_min = interval;
+		if (interval > st->interval_max) st->interval_max = interval;
+		// Welford's online mean/variance
+		st->n_frames++;
+		const double delta = (double)interval - st->interval_mean;
+		st->interval_mean += delta / st->n_frames;
+		win->frame_interval_m2 += delta * ((double)interval - st->interval_mean);
+
+		if (fps > 0 && win->frame_deadline_us > 0) {
+			const uint64_t lateness = now > win->frame_deadline_us ? now - win->frame_deadline_us : 0;
+			st->lateness_mean += ((double)lateness - st->lateness_mean) / st->n_frames;
+			if (lateness > st->lateness_max) st->lateness_max = lateness;
+		}
+	}
+	win->frame_begin_us = now;
+
+	if (fps > 0) {
+		const uint64_t period = 1000000 / fps;
+		uint64_t next = win->frame_deadline_us + period;
+		// start over if we missed a whole period; catching up would
+		// just produce a burst of frames
+		if (win->frame_deadline_us == 0 || next < now) next = now + period;
+		win->frame_deadline_us = next;
+	}
+}
+
+static void gpudl__frame_fence_callback(WGPUQueueWorkDoneStatus status, void* userdata)
+{
+	// also on error; there's nothing left to wait for then
+	(*(int*)userdata)--;
+}
+
+// starts a new application frame (and moves on to the next frame slot) if
+// the window already presented in the current one
+static void gpudl__app_frame_update(struct gpudl__window* win)
+{
+	if (win->app_frame != gpudl__runtime.app_frame) return;
+	gpudl__runtime.app_frame++;
+	if (gpudl__runtime.frames_in_flight > 0) {
+		gpudl__runtime.frame_slot = (gpudl__runtime.frame_slot + 1) % gpudl__runtime.frames_in_flight;
+	}
+}
+
+// returns 1 if the current frame slot is still in flight, optionally
+// waiting for it first
+static int gpudl__frame_slot_busy(int wait)
+{
+	int* pending = &gpudl__runtime.frame_fence_pending[gpudl__runtime.frame_slot];
+	if (*pending == 0) return 0;
+	// callbacks only fire from wgpuDevicePoll(). XXX waiting also waits
+	// for the newer frames in flight; there's no waiting for a single
+	// submission in wgpu-native
+	wgpuDevicePoll(gpudl__runtime.wgpu_device, wait);
+	return *pending > 0;
+}
+
+void gpudl_set_frames_in_flight(int n, enum gpudl_frame_wait wait)
+{
+	assert((0 <= n && n <= GPUDL_MAX_FRAMES_IN_FLIGHT) && "frames in flight out of range; see GPUDL_MAX_FRAMES_IN_FLIGHT");
+	assert((gpudl__runtime.rendering_window_id == 0) && "cannot change frames in flight while rendering");
+	if (gpudl_get_n_frames_in_flight() > 0) wgpuDevicePoll(gpudl__runtime.wgpu_device, true);
+	gpudl__runtime.frames_in_flight = n;
+	gpudl__runtime.frame_wait = wait;
+	gpudl__runtime.frame_slot = 0;
+}
+
+int gpudl_get_frame_slot(void)
+{
+	return gpudl__runtime.frame_slot;
+}
+
+int gpudl_get_n_frames_in_flight(void)
+{
+	int n = 0;
+	for (int i = 0; i < GPUDL_MAX_FRAMES_IN_FLIGHT; i++) n += gpudl__runtime.frame_fence_pending[i] > 0;
+	if (n == 0) return 0;
+	wgpuDevicePoll(gpudl__runtime.wgpu_device, false);
+	n = 0;
+	for (int i = 0; i < GPUDL_MAX_FRAMES_IN_FLIGHT; i++) n += gpudl__runtime.frame_fence_pending[i] > 0;
+	return n;
+}
+
 WGPUTextureView gpudl_render_begin(int window_id)
 {
 	assert((window_id > 0) && "invalid window id");
@@ -2202,8 +7107,47 @@ WGPUTextureView gpudl_render_begin(int window_id)
 	if (!win->wgpu_swap_chain) {
 		return NULL;
 	}
+	#ifdef GPUDL_WAYLAND
+	// acking here means the ack is committed by the present of a frame
+	// that already has the new size, so the compositor never shows a
+	// stretched or cropped frame during interactive resizes
+	if (win->wl_configure_pending) gpudl__wl_window_ack_configure(win);
+	if (win->wl_frame_callback) {
+		// compositor hasn't asked for a new frame yet (also the case
+		// while the window is hidden)
+		return NULL;
+	}
+	#else
+	// see gpudl_window_open_ex()
+	if (win->transparent_until_present && !win->mapped) return NULL;
+	#endif
+	const int fps = gpudl__window_get_fps_limit(win);
+	if (fps < 0) return NULL;
+	if (win->swap_chain_stale) {
+		gpudl__window_create_swap_chain(win);
+		win->swap_chain_stale = 0;
+	}
+	gpudl__app_frame_update(win);
+	if (gpudl__runtime.frames_in_flight > 0 && gpudl__frame_slot_busy(gpudl__runtime.frame_wait == GPUDL_FRAME_WAIT_BLOCK)) {
+		return NULL;
+	}
+	if (gpudl__runtime.stream_pumped_app_frame != gpudl__runtime.app_frame) {
+		gpudl_pump_streamed_textures();
+		gpudl__runtime.stream_pumped_app_frame = gpudl__runtime.app_frame;
+	}
+	if (fps > 0 && gpudl_time_us() < win->frame_deadline_us) {
+		// only wait if nothing else should be rendered in the meantime
+		if (gpudl__other_window_due_before(win, win->frame_deadline_us)) return NULL;
+		gpudl__sleep_until(win->frame_deadline_us);
+	}
 	WGPUTextureView view = wgpuSwapChainGetCurrentTextureView(win->wgpu_swap_chain);
 	if (view != NULL) {
+		gpudl__window_frame_begun(win, fps);
+		gpudl__uniform_ring_begin();
+		gpudl__2d_reset(1);
+		win->r2d_vertex_buffer_used = 0;
+		win->frame_input_us = win->input_us;
+		win->input_us = 0;
 		gpudl__runtime.rendering_swap_chain_texture_view = view;
 		gpudl__runtime.rendering_window_id = win->id;
 		return view;
@@ -2215,13 +7159,175 @@ WGPUTextureView gpudl_render_begin(int window_id)
 void gpudl_render_end(void)
 {
 	assert((gpudl__runtime.rendering_window_id > 0) && "not rendering a window");
+	assert((gpudl__runtime.uniform_used == 0 || gpudl__runtime.uniform_uploaded) && "allocated uniforms were never uploaded; call gpudl_upload_uniforms() before wgpuQueueSubmit()");
 	struct gpudl__window* win = gpudl__get_window(gpudl__runtime.rendering_window_id);
+	#ifdef GPUDL_WAYLAND
+	// the frame request is attached to the commit done by the present
+	win->wl_frame_callback = wl_surface_frame(win->wl_surface);
+	wl_callback_add_listener(win->wl_frame_callback, &gpudl__wl_frame_listener, GPUDL__WL_DATA(win->id));
+	#endif
+	gpudl__profiler_end_frame();
+	gpudl__2d_release_retired();
+	gpudl__window_frame_presenting(win);
 	wgpuSwapChainPresent(win->wgpu_swap_chain);
+	if (gpudl__runtime.frames_in_flight > 0) {
+		int* pending = &gpudl__runtime.frame_fence_pending[gpudl__runtime.frame_slot];
+		(*pending)++;
+		wgpuQueueOnSubmittedWorkDone(gpudl__runtime.wgpu_queue, 0, gpudl__frame_fence_callback, pending);
+	}
+	win->app_frame = gpudl__runtime.app_frame;
+	gpudl__runtime.frame_counter++;
+	if ((gpudl__runtime.frame_counter % 16) == 0) {
+		gpudl__evict_bundles();
+		gpudl__evict_bind_groups();
+	}
+	#ifndef GPUDL_WAYLAND
+	if (win->transparent_until_present == 1) {
+		if (gpudl__runtime.x11_present_opcode) {
+			// made opaque by the present's CompleteNotify
+			win->transparent_until_present = 2;
+		} else {
+			gpudl__x11_window_make_opaque(win);
+		}
+	}
+	if (win->x11_sync_state == 2) {
+		// tells the window manager that a frame at the new size is
+		// out, so it can go on with the resize
+		XSyncValue value;
+		XSyncIntsToValue(&value, (unsigned)(win->x11_sync_value & 0xffffffff), (int)(win->x11_sync_value >> 32));
+		XSyncSetCounter(gpudl__runtime.x11_display, win->x11_sync_counter, value);
+		XFlush(gpudl__runtime.x11_display);
+		win->x11_sync_state = 0;
+	}
+	#endif
 	gpudl__runtime.rendering_window_id = 0;
 	wgpuTextureViewDrop(gpudl__runtime.rendering_swap_chain_texture_view);
 	gpudl__runtime.rendering_swap_chain_texture_view = NULL;
 }
 
+int gpudl_window_get_present_timing(int window_id, struct gpudl_present_timing* timing)
+{
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	memset(timing, 0, sizeof *timing);
+	if (win->present_msc == 0) return 0;
+
+	timing->ust = win->present_ust;
+	timing->msc = win->present_msc;
+	timing->refresh_interval_us = win->refresh_interval_us;
+
+	uint64_t next = win->present_ust + win->refresh_interval_us;
+	const uint64_t now = gpudl_time_us();
+	if (win->refresh_interval_us > 0 && next <= now) {
+		const uint64_t n = (now - win->present_ust) / win->refresh_interval_us + 1;
+		next = win->present_ust + n * win->refresh_interval_us;
+	}
+	timing->next_vblank_ust = next;
+	return 1;
+}
+
+void gpudl_window_set_fullscreen(int window_id, enum gpudl_fullscreen_mode mode)
+{
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	if (win->fullscreen == mode) return;
+	const int was_fullscreen = (win->fullscreen != GPUDL_WINDOWED);
+	const int is_fullscreen = (mode != GPUDL_WINDOWED);
+	win->fullscreen = mode;
+
+	#ifdef GPUDL_WAYLAND
+	// wayland compositors scan out fullscreen surfaces directly when
+	// they can; there's nothing to ask for
+	if (is_fullscreen && !was_fullscreen) xdg_toplevel_set_fullscreen(win->xdg_toplevel, NULL);
+	if (!is_fullscreen && was_fullscreen) xdg_toplevel_unset_fullscreen(win->xdg_toplevel);
+	#else
+	Display* dpy = gpudl__runtime.x11_display;
+	if (gpudl__runtime.x11_NET_WM_STATE == None) {
+		gpudl__runtime.x11_NET_WM_STATE = XInternAtom(dpy, "_NET_WM_STATE", False);
+		gpudl__runtime.x11_NET_WM_STATE_FULLSCREEN = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
+		gpudl__runtime.x11_NET_WM_BYPASS_COMPOSITOR = XInternAtom(dpy, "_NET_WM_BYPASS_COMPOSITOR", False);
+	}
+
+	if (mode == GPUDL_FULLSCREEN_BYPASS_COMPOSITOR) {
+		const long bypass = 1;
+		XChangeProperty(dpy, win->x11_window, gpudl__runtime.x11_NET_WM_BYPASS_COMPOSITOR, XA_CARDINAL, 32, PropModeReplace, (unsigned char*)&bypass, 1);
+	} else {
+		XDeleteProperty(dpy, win->x11_window, gpudl__runtime.x11_NET_WM_BYPASS_COMPOSITOR);
+	}
+
+	if (is_fullscreen != was_fullscreen) {
+		if (win->mapped) {
+			// EWMH: mapped windows must ask the window manager
+			XEvent xe = {0};
+			xe.xclient.type = ClientMessage;
+			xe.xclient.window = win->x11_window;
+			xe.xclient.message_type = gpudl__runtime.x11_NET_WM_STATE;
+			xe.xclient.format = 32;
+			xe.xclient.data.l[0] = is_fullscreen ? 1 : 0; // _NET_WM_STATE_ADD/_REMOVE
+			xe.xclient.data.l[1] = gpudl__runtime.x11_NET_WM_STATE_FULLSCREEN;
+			xe.xclient.data.l[3] = 1; // source indication: application
+			XSendEvent(dpy, gpudl__runtime.x11_root_window, False, SubstructureRedirectMask | SubstructureNotifyMask, &xe);
+		} else if (is_fullscreen) {
+			XChangeProperty(dpy, win->x11_window, gpudl__runtime.x11_NET_WM_STATE, XA_ATOM, 32, PropModeReplace, (unsigned char*)&gpudl__runtime.x11_NET_WM_STATE_FULLSCREEN, 1);
+		} else {
+			XDeleteProperty(dpy, win->x11_window, gpudl__runtime.x11_NET_WM_STATE);
+		}
+	}
+	XFlush(dpy);
+	#endif
+
+	// the window manager's ConfigureNotify triggers the swap chain
+	// rebuild; flip/copy counts from before are meaningless now
+	win->frame_stats.n_flips = 0;
+	win->frame_stats.n_copies = 0;
+}
+
+void gpudl_set_target_fps(int window_id, int fps)
+{
+	assert((fps >= 0) && "invalid fps");
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	win->target_fps = fps;
+	win->frame_deadline_us = 0;
+}
+
+int gpudl_window_is_visible(int window_id)
+{
+	return gpudl__window_is_visible(gpudl__get_window(window_id));
+}
+
+void gpudl_set_throttle_policy(const struct gpudl_throttle_policy* policy)
+{
+	memcpy(&gpudl__runtime.throttle_policy, policy, sizeof *policy);
+	for (int i = 0; i < gpudl__runtime.n_windows; i++) {
+		gpudl__runtime.windows[i].frame_deadline_us = 0;
+	}
+}
+
+void gpudl_window_get_frame_stats(int window_id, struct gpudl_frame_stats* stats)
+{
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	memcpy(stats, &win->frame_stats, sizeof *stats);
+	if (stats->n_frames > 1) {
+		stats->interval_stddev = sqrt(win->frame_interval_m2 / (stats->n_frames - 1));
+	}
+}
+
+void gpudl_window_get_latency_histogram(int window_id, struct gpudl_latency_histogram* histogram)
+{
+	memcpy(histogram, &gpudl__get_window(window_id)->latency_histogram, sizeof *histogram);
+}
+
+void gpudl_window_reset_latency_histogram(int window_id)
+{
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	memset(&win->latency_histogram, 0, sizeof win->latency_histogram);
+}
+
+void gpudl_window_reset_frame_stats(int window_id)
+{
+	struct gpudl__window* win = gpudl__get_window(window_id);
+	memset(&win->frame_stats, 0, sizeof win->frame_stats);
+	win->frame_interval_m2 = 0;
+}
+
 WGPUTextureFormat gpudl_get_preferred_swap_chain_texture_format()
 {
 	return gpudl__runtime.wgpu_swap_chain_format;
@@ -2230,20 +7336,85 @@ WGPUTextureFormat gpudl_get_preferred_swap_chain_texture_format()
 void gpudl_set_cursor(int cursor)
 {
 	assert(0 <= cursor && cursor < GPUDL_MAX_CURSORS);
+	assert(gpudl__runtime.cursors[cursor].in_use && "no such cursor");
 	struct gpudl__window* win = gpudl__get_window(gpudl__runtime.rendering_window_id);
+	// typically called every frame, so only talk to the server on change
+	if (win->cursor == cursor) return;
+	win->cursor = cursor;
+	#ifdef GPUDL_WAYLAND
+	if (gpudl__runtime.wl_pointer_window_id == win->id) gpudl__wl_update_cursor();
+	#else
 	XDefineCursor(gpudl__runtime.x11_display, win->x11_window, gpudl__runtime.cursors[cursor].cursor);
+	#endif
 }
 
-// bitmap height is defined by the number of lines in string; width is defined
-// by string line length (each line must have same width). valid characters:
-//   ' '  mask=0
-//   '?'  mask=0, hotspot
-//   '.'  mask=1, color=black
-//   ':'  mask=1, color=black, hotspot
-//   'x'  mask=1, color=white
-//   'X'  mask=1, color=white, hotspot
-// bitmap must define 0 or 1 hotspots
-int gpudl_make_bitmap_cursor(const char* bitmap)
+static int gpudl__alloc_cursor(void)
+{
+	for (int i = GPUDL_CURSOR_END; i < GPUDL_MAX_CURSORS; i++) {
+		if (!gpudl__runtime.cursors[i].in_use) return i;
+	}
+	assert(!"too many cursors");
+	return -1;
+}
+
+#ifdef GPUDL_WAYLAND
+static void gpudl__wl_make_argb_cursor(struct gpudl__cursor* cc, int width, int height, const uint32_t* argb, int hotspot_x, int hotspot_y)
+{
+	cc->wl_buffer = gpudl__wl_create_argb_buffer(width, height, argb);
+	cc->width = width;
+	cc->height = height;
+	cc->hotspot_x = hotspot_x;
+	cc->hotspot_y = hotspot_y;
+}
+#else
+// pixels as returned by gpudl__parse_bitmap()
+static Cursor gpudl__x11_make_pixmap_cursor(const uint8_t* pixels, int width, int height, int hotspot_x, int hotspot_y)
+{
+	const int width_in_bytes = (width+7) >> 3;
+	const int bytes_in_bitmap = width_in_bytes * height;
+
+	Display* dpy = gpudl__runtime.x11_display;
+	Window drawable = DefaultRootWindow(dpy);
+
+	char* source_data = calloc(1, bytes_in_bitmap);
+	char* mask_data = calloc(1, bytes_in_bitmap);
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			const uint8_t pixel = pixels[x + y*width];
+			const int i = (x>>3) + y*width_in_bytes;
+			assert(0 <= i && i < bytes_in_bitmap);
+			const int m = 1<<(x&7);
+			if (pixel != 0) mask_data[i] |= m;
+			if (pixel == 2) source_data[i] |= m;
+		}
+	}
+
+	Pixmap source = XCreateBitmapFromData(dpy, drawable, source_data, width, height);
+	Pixmap mask = XCreateBitmapFromData(dpy, drawable, mask_data, width, height);
+
+	free(source_data);
+	free(mask_data);
+
+	Cursor cursor = XCreatePixmapCursor(
+		gpudl__runtime.x11_display,
+		source,
+		mask,
+		&gpudl__runtime.x11_color_white,
+		&gpudl__runtime.x11_color_black,
+		hotspot_x,
+		hotspot_y);
+
+	XFreePixmap(dpy, source);
+	XFreePixmap(dpy, mask);
+
+	return cursor;
+}
+#endif
+
+// parses a gpudl_make_bitmap_cursor() bitmap into one byte per pixel
+// (0=transparent, 1=black, 2=white); returned array must be free()'d
+static uint8_t* gpudl__parse_bitmap(const char* bitmap, int* width_out, int* height_out, int* hotspot_x_out, int* hotspot_y_out)
 {
 	int width = 0;
 	int height = 0;
@@ -2265,34 +7436,27 @@ int gpudl_make_bitmap_cursor(const char* bitmap)
 	}
 	assert((width > 0 && height > 0) && "empty bitmap?");
 
-	const int width_in_bytes = (width+7) >> 3;
-	const int bytes_in_bitmap = width_in_bytes * height;
-
-	Display* dpy = gpudl__runtime.x11_display;
-	Window drawable = DefaultRootWindow(dpy);
-
-	char* source_data = calloc(1, bytes_in_bitmap);
-	char* mask_data = calloc(1, bytes_in_bitmap);
+	uint8_t* pixels = calloc(width * height, 1);
 
 	int hotspot_set = 0;
 	int hotspot_x = 0;
 	int hotspot_y = 0;
 	{
 		const char* p = bitmap;
+		uint8_t* pp = pixels;
 		for (int y = 0; y < height; y++) {
 			for (int x = 0; x < width; x++) {
-				int is_mask = 0;
 				int is_hotspot = 0;
-				int color = 0;
+				uint8_t pixel = 0;
 
 				char c = *(p++);
 				switch (c) {
 				case ' ': break;
 				case '?': is_hotspot = 1; break;
-				case '.': is_mask = 1; color = 0; break;
-				case ':': is_mask = 1; color = 0; is_hotspot = 1; break;
-				case 'x': is_mask = 1; color = 1; break;
-				case 'X': is_mask = 1; color = 1; is_hotspot = 1; break;
+				case '.': pixel = 1; break;
+				case ':': pixel = 1; is_hotspot = 1; break;
+				case 'x': pixel = 2; break;
+				case 'X': pixel = 2; is_hotspot = 1; break;
 				default:
 					fprintf(stderr, "invalid character '%c' at %d,%d\n", c, x, y);
 					abort();
@@ -2300,49 +7464,138 @@ int gpudl_make_bitmap_cursor(const char* bitmap)
 
 				if (is_hotspot) {
 					assert(!hotspot_set && "multiple hotspots in bitmap");
+					hotspot_set = 1;
 					hotspot_x = x;
 					hotspot_y = y;
 				}
 
-				{
-					const int i = (x>>3) + y*width_in_bytes;
-					assert(0 <= i && i < bytes_in_bitmap);
-					const int m = 1<<(x&7);
-					if (is_mask) mask_data[i] |= m;
-					if (color)   source_data[i] |= m;
-				}
+				*(pp++) = pixel;
 			}
 			p++;
 		}
 	}
 
-	Pixmap source = XCreateBitmapFromData(dpy, drawable, source_data, width, height);
-	Pixmap mask = XCreateBitmapFromData(dpy, drawable, mask_data, width, height);
+	*width_out = width;
+	*height_out = height;
+	*hotspot_x_out = hotspot_x;
+	*hotspot_y_out = hotspot_y;
+	return pixels;
+}
 
-	free(source_data);
-	free(mask_data);
+// bitmap height is defined by the number of lines in string; width is defined
+// by string line length (each line must have same width). valid characters:
+//   ' '  mask=0
+//   '?'  mask=0, hotspot
+//   '.'  mask=1, color=black
+//   ':'  mask=1, color=black, hotspot
+//   'x'  mask=1, color=white
+//   'X'  mask=1, color=white, hotspot
+// bitmap must define 0 or 1 hotspots
+int gpudl_make_bitmap_cursor(const char* bitmap)
+{
+	// apps tend to make the same cursors over and over (e.g. per
+	// window), so identical bitmaps share a cursor
+	for (int i = GPUDL_CURSOR_END; i < GPUDL_MAX_CURSORS; i++) {
+		struct gpudl__cursor* cc = &gpudl__runtime.cursors[i];
+		if (cc->in_use && cc->bitmap && strcmp(cc->bitmap, bitmap) == 0) {
+			cc->refcount++;
+			return i;
+		}
+	}
 
-	Cursor cursor = XCreatePixmapCursor(
-		gpudl__runtime.x11_display,
-		source,
-		mask,
-		&gpudl__runtime.x11_color_white,
-		&gpudl__runtime.x11_color_black,
-		hotspot_x,
-		hotspot_y);
+	const int index = gpudl__alloc_cursor();
+	struct gpudl__cursor* cc = &gpudl__runtime.cursors[index];
 
-	XFreePixmap(dpy, source);
-	XFreePixmap(dpy, mask);
+	int width, height, hotspot_x, hotspot_y;
+	uint8_t* pixels = gpudl__parse_bitmap(bitmap, &width, &height, &hotspot_x, &hotspot_y);
 
-	for (int i = GPUDL_CURSOR_END; i < GPUDL_MAX_CURSORS; i++) {
-		struct gpudl__cursor* cc = &gpudl__runtime.cursors[i];
-		if (cc->in_use) continue;
-		cc->in_use = 1;
-		cc->cursor = cursor;
-		return i;
+	#ifdef GPUDL_WAYLAND
+	uint32_t* argb = calloc(width * height, sizeof *argb);
+	for (int i = 0; i < width*height; i++) {
+		argb[i] = pixels[i] == 1 ? 0xff000000 : pixels[i] == 2 ? 0xffffffff : 0;
 	}
+	gpudl__wl_make_argb_cursor(cc, width, height, argb, hotspot_x, hotspot_y);
+	free(argb);
+	#else
+	cc->cursor = gpudl__x11_make_pixmap_cursor(pixels, width, height, hotspot_x, hotspot_y);
+	#endif
+
+	free(pixels);
+
+	cc->bitmap = strdup(bitmap);
+	cc->refcount = 1;
+	cc->in_use = 1;
+	return index;
+}
 
-	assert(!"too many cursors");
+int gpudl_make_argb_cursor(int width, int height, const uint32_t* pixels, int hotspot_x, int hotspot_y)
+{
+	assert(width > 0 && height > 0);
+	assert(0 <= hotspot_x && hotspot_x < width && 0 <= hotspot_y && hotspot_y < height);
+
+	const int index = gpudl__alloc_cursor();
+	struct gpudl__cursor* cc = &gpudl__runtime.cursors[index];
+
+	#ifdef GPUDL_WAYLAND
+	gpudl__wl_make_argb_cursor(cc, width, height, pixels, hotspot_x, hotspot_y);
+	#else
+	if (XcursorSupportsARGB(gpudl__runtime.x11_display)) {
+		XcursorImage* img = XcursorImageCreate(width, height);
+		assert(img && "XcursorImageCreate() failed");
+		img->xhot = hotspot_x;
+		img->yhot = hotspot_y;
+		memcpy(img->pixels, pixels, width * height * sizeof *pixels);
+		cc->cursor = XcursorImageLoadCursor(gpudl__runtime.x11_display, img);
+		XcursorImageDestroy(img);
+	} else {
+		// no RENDER extension; threshold into a 2-color cursor
+		uint8_t* bw = calloc(width * height, 1);
+		for (int i = 0; i < width*height; i++) {
+			const uint32_t p = pixels[i];
+			const int a = p >> 24;
+			const int luma = (((p>>16)&0xff)*2 + ((p>>8)&0xff)*5 + (p&0xff)) >> 3;
+			bw[i] = a < 0x80 ? 0 : luma < (a>>1) ? 1 : 2;
+		}
+		cc->cursor = gpudl__x11_make_pixmap_cursor(bw, width, height, hotspot_x, hotspot_y);
+		free(bw);
+	}
+	#endif
+
+	cc->refcount = 1;
+	cc->in_use = 1;
+	return index;
+}
+
+static void gpudl__windows_drop_cursor(struct gpudl__window* windows, int n, int cursor)
+{
+	for (int i = 0; i < n; i++) {
+		struct gpudl__window* win = &windows[i];
+		if (win->cursor != cursor) continue;
+		win->cursor = GPUDL_CURSOR_DEFAULT;
+		#ifdef GPUDL_WAYLAND
+		if (gpudl__runtime.wl_pointer_window_id == win->id) gpudl__wl_update_cursor();
+		#else
+		XDefineCursor(gpudl__runtime.x11_display, win->x11_window, gpudl__runtime.cursors[GPUDL_CURSOR_DEFAULT].cursor);
+		#endif
+	}
+}
+
+void gpudl_free_cursor(int cursor)
+{
+	assert((GPUDL_CURSOR_END <= cursor && cursor < GPUDL_MAX_CURSORS) && "not a custom cursor");
+	struct gpudl__cursor* cc = &gpudl__runtime.cursors[cursor];
+	assert(cc->in_use && cc->refcount > 0 && "cursor already freed");
+	if (--cc->refcount > 0) return;
+
+	gpudl__windows_drop_cursor(gpudl__runtime.windows, gpudl__runtime.n_windows, cursor);
+	#ifdef GPUDL_WAYLAND
+	wl_buffer_destroy(cc->wl_buffer);
+	#else
+	gpudl__windows_drop_cursor(gpudl__runtime.pooled_windows, gpudl__runtime.n_pooled_windows, cursor);
+	XFreeCursor(gpudl__runtime.x11_display, cc->cursor);
+	#endif
+	free(cc->bitmap);
+	memset(cc, 0, sizeof *cc);
 }
 
 #if 0